@@ -0,0 +1,112 @@
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "AsyncLog.hpp"
+#include "Logger.hpp"
+
+using namespace std;
+
+namespace
+{
+	static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t));
+	
+	void FutexWait(atomic<uint32_t>& word, uint32_t value)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+	}
+	
+	void FutexWake(atomic<uint32_t>& word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+}
+
+AsyncLog& AsyncLog::Instance()
+{
+	static AsyncLog log;
+	return log;
+}
+
+AsyncLog::AsyncLog() : m_cells(new Cell[QUEUE_SIZE])
+{
+	for (size_t i = 0; i < QUEUE_SIZE; ++i) { m_cells[i].seq.store(i, memory_order_relaxed); }
+	m_thread = thread([this]{ Drain(); });
+}
+
+AsyncLog::~AsyncLog()
+{
+	m_is_stopped.store(true, memory_order_release);
+	Wake();
+	m_thread.join();
+}
+
+void AsyncLog::Push(std::string_view text)
+{
+	//bounded MPMC queue by D.Vyukov, cell sequence tells whether it is free for position
+	size_t pos = m_enqueue_pos.load(memory_order_relaxed);
+	Cell* cell;
+	while (1)
+	{
+		cell = &m_cells[pos & (QUEUE_SIZE - 1)];
+		size_t const seq = cell->seq.load(memory_order_acquire);
+		intptr_t const dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+		if (0 == dif)
+		{
+			if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+		}
+		else if (dif < 0)
+		{
+			m_dropped.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			pos = m_enqueue_pos.load(memory_order_relaxed);
+		}
+	}
+	cell->size = min(text.size(), RECORD_SIZE);
+	memcpy(cell->text, text.data(), cell->size);
+	cell->seq.store(pos + 1, memory_order_release);
+	//pairs with the fence of Drain: either it sees the record or this sees it sleeping
+	atomic_thread_fence(memory_order_seq_cst);
+	if (m_is_sleeping.load(memory_order_relaxed)) { Wake(); }
+}
+
+void AsyncLog::Wake()
+{
+	m_wakeups.fetch_add(1, memory_order_release);
+	FutexWake(m_wakeups);
+}
+
+void AsyncLog::Drain()
+{
+	size_t reported_dropped = 0;
+	while (1)
+	{
+		Cell& cell = m_cells[m_dequeue_pos & (QUEUE_SIZE - 1)];
+		if (cell.seq.load(memory_order_acquire) == m_dequeue_pos + 1)
+		{
+			utils::Log(string_view{cell.text, cell.size});
+			cell.seq.store(m_dequeue_pos + QUEUE_SIZE, memory_order_release);
+			++m_dequeue_pos;
+			continue;
+		}
+		
+		if (size_t const dropped = GetDropped(); dropped != reported_dropped)
+		{
+			utils::Log("AsyncLog.cpp: ", dropped - reported_dropped, " log records were dropped");
+			reported_dropped = dropped;
+		}
+		//queue is empty, everything pushed before stop is already written
+		if (m_is_stopped.load(memory_order_acquire)) break;
+		
+		//the queue is checked again after sleeping is announced, so record pushed meanwhile is not missed
+		uint32_t const wakeups = m_wakeups.load(memory_order_acquire);
+		m_is_sleeping.store(true, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (cell.seq.load(memory_order_acquire) != m_dequeue_pos + 1 and not m_is_stopped.load(memory_order_acquire)) {
+			FutexWait(m_wakeups, wakeups);
+		}
+		m_is_sleeping.store(false, memory_order_relaxed);
+	}
+}
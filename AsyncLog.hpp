@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : uint8_t
+{
+	TRACE,
+	DEBUG,
+	INFO,
+	WARNING,
+	ERROR,
+	NONE
+};
+
+//messages below this level are removed by compiler, set by PROTEY_CLIENT_LOG_LEVEL cmake option
+#ifndef CLIENT_LOG_LEVEL
+#define CLIENT_LOG_LEVEL INFO
+#endif
+inline constexpr LogLevel MIN_LOG_LEVEL = LogLevel::CLIENT_LOG_LEVEL;
+
+//Log records are formatted by caller into lock-free bounded queue and written
+//by background thread, so network path does not wait for log output.
+//If the queue is full the record is dropped and counted.
+//Background thread sleeps in futex while the queue is empty, Push wakes it only then.
+class AsyncLog
+{
+	static constexpr std::size_t RECORD_SIZE = 248;
+	static constexpr std::size_t QUEUE_SIZE = 4096;//must be power of 2
+public:
+	static AsyncLog& Instance();
+	~AsyncLog();
+	
+	template<class ... Args>
+	void Push(Args const& ... args)
+	{
+		char text[RECORD_SIZE];
+		Formatter f{text, text + RECORD_SIZE};
+		(f.Append(args), ...);
+		Push(std::string_view{text, static_cast<std::size_t>(f.pos - text)});
+	}
+	void Push(std::string_view text);
+	std::size_t GetDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+private:
+	AsyncLog();
+	void Drain();
+	void Wake();
+	
+	struct Formatter
+	{
+		char* pos;
+		char* end;
+		template<class T>
+		void Append(T const& arg)
+		{
+			if constexpr (std::is_same_v<T, char>)
+			{
+				if (pos != end) { *pos++ = arg; }
+			}
+			else if constexpr (std::is_same_v<T, bool>)
+			{
+				Append(std::string_view{arg ? "true" : "false"});
+			}
+			else if constexpr (std::is_integral_v<T>)
+			{
+				//long answer truncates the record, numbers are cut silently too
+				pos = std::to_chars(pos, end, arg).ptr;
+			}
+			else
+			{
+				std::string_view const sv{arg};
+				std::size_t const len = std::min<std::size_t>(sv.size(), end - pos);
+				memcpy(pos, sv.data(), len);
+				pos += len;
+			}
+		}
+	};
+	
+	struct Cell
+	{
+		std::atomic<std::size_t> seq;
+		uint16_t                 size;
+		char                     text[RECORD_SIZE];
+	};
+	std::unique_ptr<Cell[]>  m_cells;
+	alignas(64) std::atomic<std::size_t> m_enqueue_pos{0};
+	alignas(64) std::size_t              m_dequeue_pos{0};
+	std::atomic<std::size_t> m_dropped{0};
+	std::atomic<bool>        m_is_stopped{false};
+	//futex word changed by every wake, background thread sleeps on it while m_is_sleeping
+	std::atomic<uint32_t>    m_wakeups{0};
+	std::atomic<bool>        m_is_sleeping{false};
+	std::thread              m_thread;
+};
+
+template<LogLevel level, class ... Args>
+void AsyncLogPush(Args const& ... args)
+{
+	if constexpr (level >= MIN_LOG_LEVEL)
+	{
+		AsyncLog::Instance().Push(args...);
+	}
+}
@@ -6,34 +6,44 @@
 #include <errno.h>
 #include <charconv>
 #include <poll.h>
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <climits>
 #include <vector>
 #include <algorithm>
+#include <fcntl.h>
 #include "Client.hpp"
-#include "Logger.hpp"
+#include "UdpPacket.hpp"
+#include "TcpPacket.hpp"
+#include "UdpFragmenter.hpp"
+#include "UdpRequestTimer.hpp"
+#include "AsyncLog.hpp"
 
 using namespace std;
+using Counter_e = ClientMetrics::Counter_e;
 
-template<class ... Args>
-void Log(Args&& ... args)
+//DEBUG is for per request messages, TRACE is for per packet ones
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
 {
-	utils::Log("Client.cpp: ", forward<Args>(args)...);
+	AsyncLogPush<level>("Client.cpp: ", args...);
 }
 
-constexpr string_view      UDP_PACKET_BEGIN {"proteyclient"};
-
 constexpr string_view      tcp_proto{"TCP"};
 constexpr string_view      udp_proto{"UDP"};
 
 constexpr size_t sv_npos = string_view::npos;
-constexpr size_t TCP_READ_BUFFER_SIZE = 25;
-
-
-constexpr uint16_t UDP_PH_QTY_POS         = UDP_PACKET_BEGIN.size();
-constexpr uint16_t UDP_PH_SEQ_NUM_POS     = UDP_PH_QTY_POS + 2;
-constexpr uint16_t UDP_PH_SIZE_POS        = UDP_PH_SEQ_NUM_POS + 2;
-constexpr uint16_t UDP_PACKET_HEADER_SIZE = UDP_PH_SIZE_POS + 2;
 
 Client::Res_e Client::ValidateInputParams(std::string_view params)
+{
+	if (auto const res = ParseParams(params, m_proto, m_server_sa, &m_tcp_framing); Res_e::SUCCESS != res) { return res; }
+	//standby replaces connection, so it has to speak the same protocol
+	if (m_has_standby and (IPPROTO_TCP != m_proto or m_standby_framing != m_tcp_framing)) return Res_e::INVALID_PROTOCOL_INPUT_PARAMETER;
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::ParseParams(std::string_view params, int& proto_out, sockaddr_in& server_sa, Framing_e* framing)
 {
 	auto const pos1 = params.find_first_of(",");
 	if (pos1 == sv_npos or pos1 == (params.size() - 1))
@@ -46,41 +56,40 @@ Client::Res_e Client::ValidateInputParams(std::string_view params)
 		return Res_e::NOT_ALL_INPUT_PARAMETERS_ARE_SET;
 	}
 	auto const proto = params.substr(0, pos1); 
-	if (proto == tcp_proto) m_proto = IPPROTO_TCP;
-	else if (proto == udp_proto) m_proto = IPPROTO_UDP;
+	if (proto == tcp_proto) proto_out = IPPROTO_TCP;
+	else if (proto == udp_proto) proto_out = IPPROTO_UDP;
+	else if (proto == tcpbin_proto and framing) proto_out = IPPROTO_TCP;
 	else return Res_e::INVALID_PROTOCOL_INPUT_PARAMETER;
+	if (framing) { *framing = (proto == tcpbin_proto) ? Framing_e::LENGTH_PREFIXED : Framing_e::LINE; }
 
 	auto const ip_len = pos2 - pos1 - 1;
 	if (ip_len > MAX_IPv4_SIZE) return Res_e::INVALID_IPv4_INPUT_PARAMETER;
-	if (params.size() - pos2 - 1 > sizeof(65535)) return Res_e::INVALID_PORT_INPUT_PARAMETER;
+	if (params.size() - pos2 - 1 > MAX_PORT_SIZE) return Res_e::INVALID_PORT_INPUT_PARAMETER;
 	
-	memset(&m_server_sa, 0, sizeof(m_server_sa));
+	memset(&server_sa, 0, sizeof(server_sa));
 	
 	char ip_term[MAX_IPv4_SIZE + 1];
 	memcpy(ip_term, &params[pos1 + 1], ip_len);
 	ip_term[ip_len] = '\0';
-	if (1 != inet_pton(AF_INET, ip_term, &m_server_sa.sin_addr)) return Res_e::INVALID_IPv4_INPUT_PARAMETER;
+	if (1 != inet_pton(AF_INET, ip_term, &server_sa.sin_addr)) return Res_e::INVALID_IPv4_INPUT_PARAMETER;
 	
 	uint16_t server_port;
-	if (from_chars(&params[pos2 + 1], params.end(), server_port).ptr != params.end()) return Res_e::INVALID_PORT_INPUT_PARAMETER;
-	m_server_sa.sin_port = htons(server_port);
+	if (auto const [ptr, ec] = from_chars(&params[pos2 + 1], params.end(), server_port); ptr != params.end() or ec != errc{}) return Res_e::INVALID_PORT_INPUT_PARAMETER;
+	server_sa.sin_port = htons(server_port);
 	
-	m_server_sa.sin_family = AF_INET;
+	server_sa.sin_family = AF_INET;
 	
 	return Res_e::SUCCESS;
 }
 
 Client::Res_e Client::ErrorHandlingExceptEINTR(bool IsWrite)
 {
-	if(errno == ECONNRESET)
+	if(errno == ECONNRESET or errno == EPIPE)
 	{
-		Log("Connection is broken and socket ", m_desc, " will be closed");
-		close(m_desc);
-		m_desc = -1;
-		m_is_started = false;
+		OnConnectionBroken();
 		return Res_e::CONNECTION_BROKEN;	
 	}
-	Log(IsWrite ? "Write" : "Read", " to server failed: ", strerror(errno));
+	Log<LogLevel::ERROR>(IsWrite ? "Write" : "Read", " to server failed: ", strerror(errno));
 	if ((errno == ENOBUFS) or (errno == ENOMEM)) {
 		return Res_e::TEMPORARY_UNSUFFICIENT_RESOURCES;
 	}
@@ -95,8 +104,10 @@ Client::~Client()
 	if (-1 != m_desc)
 	{
 		close(m_desc);
-		Log(m_proto == IPPROTO_TCP ? tcp_proto : udp_proto, " socket ", m_desc, " was closed");
+		Log<LogLevel::INFO>(m_proto == IPPROTO_TCP ? tcp_proto : udp_proto, " socket ", m_desc, " was closed");
 	}
+	if (-1 != m_standby_desc) { close(m_standby_desc); }
+	StopReconnect();
 }		
 
 Client::Res_e Client::Start(std::string_view params)
@@ -108,270 +119,939 @@ Client::Res_e Client::Start(std::string_view params)
 	return Start();
 }
 	
-Client::Res_e Client::Start()
+int Client::CreateSocket(int type, Res_e& res)
 {
-	m_desc = socket(AF_INET, (m_proto == IPPROTO_TCP) ? SOCK_STREAM : SOCK_DGRAM, m_proto);
-	if (-1 == m_desc)
+	int const desc = socket(AF_INET, type, m_proto);
+	if (-1 == desc)
 	{
-		Log("Creation of an unbound socket and get file descriptor failed: ", strerror(errno));
+		Log<LogLevel::ERROR>("Creation of an unbound socket and get file descriptor failed: ", strerror(errno));
 		if ((errno == ENFILE)or(errno == EMFILE)or(errno == ENOBUFS)or(errno == ENOMEM))
 		{
-			Log("You can try to create socket later");
-			return Res_e::TEMPORARY_UNSUFFICIENT_RESOURCES;
+			Log<LogLevel::WARNING>("You can try to create socket later");
+			res = Res_e::TEMPORARY_UNSUFFICIENT_RESOURCES;
 		}
+		else res = Res_e::FAILURE;
+	}
+	return desc;
+}
+
+int Client::StartConnect(sockaddr_in const& sa, Res_e& res)
+{
+	//connect does not block, its completion is waited by poll with timeout
+	int const desc = CreateSocket(SOCK_STREAM | SOCK_NONBLOCK, res);
+	if (-1 == desc) return -1;
+	if (-1 == connect(desc, (sockaddr const*)&sa, sizeof(sa)) and errno != EINPROGRESS and errno != EINTR)
+	{
+		Log<LogLevel::ERROR>("Connect to TCP server failed: ", strerror(errno));
+		close(desc);
+		res = Res_e::FAILURE;
+		return -1;
+	}
+	return desc;
+}
+
+Client::Res_e Client::FinishConnect(int desc, std::chrono::milliseconds timeout)
+{
+	auto const deadline = chrono::steady_clock::now() + timeout;
+	pollfd pfd{desc, POLLOUT, 0};
+	while (1)
+	{
+		auto const now = chrono::steady_clock::now();
+		auto const wait = chrono::duration_cast<chrono::nanoseconds>(max(deadline - now, chrono::steady_clock::duration::zero())).count();
+		timespec const ts{static_cast<time_t>(wait/1000000000), static_cast<long>(wait%1000000000)};
+		int const ready = ppoll(&pfd, 1, &ts, nullptr);
+		if (1 == ready) break;
+		if (0 == ready) return Res_e::TIMEOUT;
+		if (errno != EINTR)
+		{
+			Log<LogLevel::ERROR>("Connect to TCP server failed: ", strerror(errno));
+			return Res_e::FAILURE;
+		}
+	}
+	int error = 0;
+	socklen_t len = sizeof(error);
+	if (-1 == getsockopt(desc, SOL_SOCKET, SO_ERROR, &error, &len) or 0 != error)
+	{
+		Log<LogLevel::ERROR>("Connect to TCP server failed: ", strerror(error ? error : errno));
 		return Res_e::FAILURE;
 	}
-	Log(IPPROTO_TCP == m_proto ? tcp_proto : udp_proto, " socket ", m_desc, " is created");
-	
+	//the rest of Client works with blocking socket
+	if (-1 == fcntl(desc, F_SETFL, fcntl(desc, F_GETFL) & ~O_NONBLOCK))
+	{
+		Log<LogLevel::ERROR>("Reset of O_NONBLOCK failed: ", strerror(errno));
+		return Res_e::FAILURE;
+	}
+	return Res_e::SUCCESS;
+}
+
+void Client::UseConnection(int desc)
+{
+	m_desc = desc;
+	m_is_started = true;
+	Log<LogLevel::INFO>("Socket ", m_desc, " connected to TCP server");
+	if (m_tcp_zerocopy_threshold > 0)
+	{
+		int const on = 1;
+		if (-1 == setsockopt(m_desc, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)))
+		{
+			Log<LogLevel::WARNING>("TCP zero copy is not supported and will be disabled: ", strerror(errno));
+			m_tcp_zerocopy_threshold = 0;
+		}
+	}
+	m_tcp_zerocopy_sent = m_tcp_zerocopy_completed = 0;
+	//data of the previous connection is not valid anymore
+	m_tcp_rd_buffer.Clear();
+	m_tcp_answer_size_known = false;
+}
+
+Client::Res_e Client::Start()
+{
+	StopReconnect();
 	if (IPPROTO_TCP == m_proto)
-	{	
-		if (-1 == connect(m_desc, (sockaddr const*)&m_server_sa, sizeof(m_server_sa)))
+	{
+		Res_e res;
+		int const desc = StartConnect(m_server_sa, res);
+		if (-1 == desc) return res;
+		if (res = FinishConnect(desc, m_connect_timeout); Res_e::SUCCESS != res)
 		{
-			Log("Connect to TCP server failed: ", strerror(errno));
-			if (errno == EINTR)
-			{
-				pollfd pfd;
-				pfd.fd = m_desc;
-				pfd.events = POLLOUT;
-				while(1)
-				{
-					int res = poll(&pfd, 1, -1);
-					if (1 == res)
-					{
-						if (not pfd.revents&POLLOUT or pfd.revents&POLLERR){ break; }
-
-						socklen_t len = sizeof(res);
-						if (-1 == getsockopt(m_desc, SOL_SOCKET, SO_ERROR, &res, &len)) { break; }
-						if (res != 0) { break; } 
-						
-						Log("Socket ", m_desc, " connected to TCP server");
-						m_is_started = true;
-						return Res_e::SUCCESS;
-					}
-					else//0 value(timer expired) is impossible because third param in poll call is -1
-					{
-						if (errno != EINTR) {
-							Log("Connect to TCP server failed after EINTR: ", strerror(errno));
-							break;
-						}
-						pfd.revents = 0;
-					}
-				}				
-				
+			if (Res_e::TIMEOUT == res) {
+				Log<LogLevel::ERROR>("Connect to TCP server is not completed in ", m_connect_timeout.count(), " ms");
 			}
-			Log("Socket ", m_desc, " will be closed");
-			close(m_desc);
-			m_desc = -1;
-			return Res_e::FAILURE; 
+			close(desc);
+			return res;
 		}
-		
-		Log("Socket ", m_desc, " connected to TCP server");
+		UseConnection(desc);
+		if (m_has_standby and -1 == m_standby_desc) { m_standby_desc = StartConnect(m_standby_sa, res); }
+		return Res_e::SUCCESS;
 	}
 	
+	Res_e res;
+	m_desc = CreateSocket(SOCK_DGRAM, res);
+	if (-1 == m_desc) return res;
+	Log<LogLevel::INFO>(udp_proto, " socket ", m_desc, " is created");
+	if (m_udp_connected and -1 == connect(m_desc, (sockaddr const*)&m_server_sa, sizeof(m_server_sa)))
+	{
+		Log<LogLevel::ERROR>("Connect of UDP socket failed: ", strerror(errno));
+		close(m_desc);
+		m_desc = -1;
+		return Res_e::FAILURE;
+	}
+	//do not let datagrams to be fragmented by IP, they are already fit to path MTU
+	int const pmtu_mode = IP_PMTUDISC_DO;
+	if (-1 == setsockopt(m_desc, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu_mode, sizeof(pmtu_mode)))
+	{
+		Log<LogLevel::WARNING>("Set IP_MTU_DISCOVER failed: ", strerror(errno));
+	}
+	m_udp_packet_size = UdpFragmenter::DiscoverPacketSize(m_server_sa, m_udp_cfg_packet_size);
+	Log<LogLevel::INFO>("UDP packet size is ", m_udp_packet_size);
+	m_udp_fragmenter.SetMessageId(m_udp_has_msg_id);
+	m_udp_reassembler.SetMessageId(m_udp_has_msg_id);
+	//resend request is built without allocations
+	m_udp_missing.reserve(UdpResendMaxQty(MAX_UDP_PACKET_SIZE));
+	m_udp_resend_packet.reserve(MAX_UDP_PACKET_SIZE);
+	
+	if (m_udp_gso) { SetUdpGsoSize(); }
+	
 	m_is_started = true;
 	return Res_e::SUCCESS;
 }
 
-Client::Res_e Client::SendMsg(std::string const& msg)
+void Client::SetUdpGsoSize()
 {
-	if (not m_is_started) return Res_e::NOT_STARTED;
-	if (msg.empty()) return Res_e::NO_DATA_TO_SEND;
-	Log("Socket ", m_desc, " starts sending request with size ", msg.size(), " bytes");
+	int const gso_size = m_udp_packet_size;
+	if (-1 == setsockopt(m_desc, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)))
+	{
+		Log<LogLevel::WARNING>("UDP GSO is not supported and will be disabled: ", strerror(errno));
+		m_udp_gso = false;
+	}
+}
+
+Client::Res_e Client::StartInBackground(std::string_view params)
+{
+	if (m_is_started or m_is_reconnecting) return Res_e::ALREADY_STARTED;
 	
-	if (IPPROTO_TCP == m_proto)
+	if (auto const res = ValidateInputParams(params); Res_e::SUCCESS != res) { return res; }
+	
+	if (IPPROTO_TCP != m_proto) return Start();
+	m_is_reconnecting = true;
+	m_reconnect_delay = MIN_RECONNECT_DELAY;
+	m_reconnect_at = chrono::steady_clock::now();
+	return Reconnect();
+}
+
+Client::Res_e Client::SetStandbyServer(std::string_view params)
+{
+	int proto;
+	Framing_e framing;
+	sockaddr_in standby_sa;
+	if (auto const res = ParseParams(params, proto, standby_sa, &framing); Res_e::SUCCESS != res) { return res; }
+	if (IPPROTO_TCP != proto) return Res_e::INVALID_PROTOCOL_INPUT_PARAMETER;
+	//framing of connection is known only after Start, so it is checked again there
+	bool const is_framing_known = m_is_started or m_is_reconnecting;
+	if (is_framing_known and (IPPROTO_TCP != m_proto or framing != m_tcp_framing)) return Res_e::INVALID_PROTOCOL_INPUT_PARAMETER;
+	m_standby_sa = standby_sa;
+	m_standby_framing = framing;
+	m_has_standby = true;
+	if (-1 != m_standby_desc)
 	{
-		size_t start_pos = 0;
-		size_t len_to_send = msg.size();
-		while(msg.size() != start_pos)
+		close(m_standby_desc);
+		m_standby_desc = -1;
+	}
+	//started client gets standby connection at once, otherwise it is opened by Start
+	if (m_is_started)
+	{
+		Res_e res;
+		m_standby_desc = StartConnect(m_standby_sa, res);
+	}
+	return Res_e::SUCCESS;
+}
+
+bool Client::TakeStandby()
+{
+	if (-1 == m_standby_desc) return false;
+	int const desc = m_standby_desc;
+	m_standby_desc = -1;
+	//idle connected socket is only writable, readable one is closed by server, not writable one is still connecting
+	pollfd pfd{desc, POLLOUT | POLLIN, 0};
+	if (1 != poll(&pfd, 1, 0) or pfd.revents != POLLOUT or Res_e::SUCCESS != FinishConnect(desc, chrono::milliseconds{0}))
+	{
+		Log<LogLevel::WARNING>("Standby socket ", desc, " is not connected and will be closed");
+		close(desc);
+		return false;
+	}
+	Log<LogLevel::WARNING>("Socket ", desc, " replaces broken connection");
+	UseConnection(desc);
+	Res_e res;
+	m_standby_desc = StartConnect(m_standby_sa, res);
+	return true;
+}
+
+void Client::OnConnectionBroken()
+{
+	Log<LogLevel::WARNING>("Connection is broken and socket ", m_desc, " will be closed");
+	close(m_desc);
+	m_desc = -1;
+	m_is_started = false;
+	if (IPPROTO_TCP != m_proto or TakeStandby() or not m_reconnect) return;
+	m_is_reconnecting = true;
+	m_reconnect_delay = MIN_RECONNECT_DELAY;
+	m_reconnect_at = chrono::steady_clock::now();
+	Reconnect();
+}
+
+Client::Res_e Client::Reconnect()
+{
+	if (m_is_started) return Res_e::SUCCESS;
+	if (not m_is_reconnecting) return Res_e::NOT_STARTED;
+	auto const now = chrono::steady_clock::now();
+	if (-1 == m_reconnect_desc)
+	{
+		if (now < m_reconnect_at) return Res_e::RECONNECTING;
+		Res_e res;
+		m_reconnect_desc = StartConnect(m_server_sa, res);
+		m_reconnect_started = now;
+		if (-1 == m_reconnect_desc)
 		{
-			int written_bytes = send(m_desc, msg.data() + start_pos, len_to_send, 0);
-			if (-1 == written_bytes)
+			ScheduleReconnect(now);
+			return Res_e::RECONNECTING;
+		}
+	}
+	pollfd pfd{m_reconnect_desc, POLLOUT, 0};
+	if (0 == poll(&pfd, 1, 0) and now - m_reconnect_started < m_connect_timeout) return Res_e::RECONNECTING;
+	if (0 == pfd.revents or Res_e::SUCCESS != FinishConnect(m_reconnect_desc, chrono::milliseconds{0}))
+	{
+		close(m_reconnect_desc);
+		m_reconnect_desc = -1;
+		ScheduleReconnect(now);
+		return Res_e::RECONNECTING;
+	}
+	UseConnection(m_reconnect_desc);
+	m_reconnect_desc = -1;
+	m_is_reconnecting = false;
+	if (m_has_standby and -1 == m_standby_desc)
+	{
+		Res_e res;
+		m_standby_desc = StartConnect(m_standby_sa, res);
+	}
+	return Res_e::SUCCESS;
+}
+
+void Client::ScheduleReconnect(std::chrono::steady_clock::time_point now)
+{
+	//random half of delay keeps clients of restarted server from reconnecting all at once
+	auto const half = m_reconnect_delay/2;
+	auto const jitter = chrono::milliseconds(uniform_int_distribution<int64_t>(0, half.count())(m_random));
+	m_reconnect_at = now + half + jitter;
+	Log("Socket reconnect is delayed by ", (half + jitter).count(), " ms");
+	m_reconnect_delay = min(2*m_reconnect_delay, MAX_RECONNECT_DELAY);
+}
+
+void Client::StopReconnect()
+{
+	if (-1 != m_reconnect_desc) { close(m_reconnect_desc); }
+	m_reconnect_desc = -1;
+	m_is_reconnecting = false;
+}
+
+bool Client::AppendTcpRequest(iovec const* iov, std::size_t iovcnt, uint32_t& header)
+{
+	if (Framing_e::LENGTH_PREFIXED == m_tcp_framing)
+	{
+		size_t msg_size = 0;
+		for (size_t i = 0; i < iovcnt; ++i) { msg_size += iov[i].iov_len; }
+		if (msg_size > UINT32_MAX) return false;
+		header = htonl(msg_size);
+		m_tcp_wr_iovs.push_back({&header, TCP_BIN_HEADER_SIZE});
+		m_tcp_wr_iovs.insert(m_tcp_wr_iovs.end(), iov, iov + iovcnt);
+	}
+	else
+	{
+		static char end = TCP_LINE_END;
+		m_tcp_wr_iovs.insert(m_tcp_wr_iovs.end(), iov, iov + iovcnt);
+		m_tcp_wr_iovs.push_back({&end, 1});
+	}
+	return true;
+}
+
+Client::Res_e Client::WriteTcpRequest(iovec const* iov, std::size_t iovcnt, bool zerocopy_allowed)
+{
+	m_tcp_wr_iovs.clear();
+	m_tcp_wr_headers.resize(1);
+	if (not AppendTcpRequest(iov, iovcnt, m_tcp_wr_headers[0])) return Res_e::FAILURE;
+	return WriteTcpIovs(zerocopy_allowed, false);
+}
+
+Client::Res_e Client::WriteTcpIovs(bool zerocopy_allowed, bool is_pipelined)
+{
+	//requests and their framing are sent by one call, iovecs are advanced on partial write
+	size_t len_to_send = 0;
+	for (auto const& v : m_tcp_wr_iovs) { len_to_send += v.iov_len; }
+	//broken connection is reported by EPIPE instead of SIGPIPE
+	int flags = MSG_NOSIGNAL | (is_pipelined ? MSG_DONTWAIT : 0);
+	if (zerocopy_allowed and m_tcp_zerocopy_threshold > 0 and len_to_send >= m_tcp_zerocopy_threshold) { flags |= MSG_ZEROCOPY; }
+	
+	size_t first = 0;
+	while (len_to_send > 0)
+	{
+		msghdr hdr{};
+		hdr.msg_iov = &m_tcp_wr_iovs[first];
+		hdr.msg_iovlen = min<size_t>(m_tcp_wr_iovs.size() - first, IOV_MAX);
+		m_metrics.Add(Counter_e::SYSCALLS);
+		ssize_t written_bytes = sendmsg(m_desc, &hdr, flags);
+		if (-1 == written_bytes)
+		{
+			if (errno == EINTR)
 			{
-				if (errno == EINTR)
-				{
-					Log("EINTR is received.Try again send message");
-					continue;
-				}
-				return ErrorHandlingExceptEINTR(true);
+				Log("EINTR is received.Try again send message");
+				m_metrics.Add(Counter_e::EINTR_RETRIES);
+				continue;
 			}
-			else
+			if (errno == ENOBUFS and (flags & MSG_ZEROCOPY))
 			{
-				Log("Socket ", m_desc, " write ", written_bytes, " bytes");
-				start_pos += written_bytes;
-				len_to_send = msg.size() - start_pos;
+				Log<LogLevel::WARNING>("Zero copy send is limited by socket memory, data will be copied");
+				flags &= ~MSG_ZEROCOPY;
+				continue;
 			}
+			if (is_pipelined and (errno == EAGAIN or errno == EWOULDBLOCK))
+			{
+				if (auto const res = WaitWritable(); Res_e::SUCCESS != res) { return res; }
+				continue;
+			}
+			return ErrorHandlingExceptEINTR(true);
 		}
-		
-		char end = '\n';
-		while(1)
+		Log<LogLevel::TRACE>("Socket ", m_desc, " write ", written_bytes, " bytes");
+		//every zero copy call is confirmed by one notification in error queue
+		if ((flags & MSG_ZEROCOPY) and written_bytes > 0) { ++m_tcp_zerocopy_sent; }
+		m_metrics.Add(Counter_e::BYTES_OUT, written_bytes);
+		if (static_cast<size_t>(written_bytes) < len_to_send)
 		{
-			if (-1 == send(m_desc, &end, 1, 0))
+			m_metrics.Add(Counter_e::PARTIAL_WRITES);
+			//server may stop reading requests until its answers are read
+			if (is_pipelined)
 			{
-				if (errno == EINTR)
-				{
-					Log("EINTR is received.Try again send message");
-					continue;
-				}
-				return ErrorHandlingExceptEINTR(true);	
+				if (auto const res = Poll(); Res_e::SUCCESS != res) { return res; }
 			}
-			break;
 		}
-		Log("Socket ", m_desc, " write END byte");
-		
-		char buffer[TCP_READ_BUFFER_SIZE];
-		m_last_received_answer.clear();
-		while(1) 
-		{ 
-			int read_bytes = read(m_desc, buffer, TCP_READ_BUFFER_SIZE);
+		len_to_send -= written_bytes;
+		while (written_bytes > 0)
+		{
+			iovec& v = m_tcp_wr_iovs[first];
+			size_t const chunk = min<size_t>(v.iov_len, written_bytes);
+			v.iov_base = static_cast<char*>(v.iov_base) + chunk;
+			v.iov_len -= chunk;
+			written_bytes -= chunk;
+			if (0 == v.iov_len) { ++first; }
+		}
+	}
+	return Res_e::SUCCESS;
+}
 
-			if (-1 == read_bytes)
+Client::Res_e Client::WaitWritable()
+{
+	//answers are read while waiting, otherwise server blocked on writing them and client blocked
+	//on writing requests would wait for each other forever
+	while (1)
+	{
+		if (auto const res = Poll(); Res_e::SUCCESS != res) { return res; }
+		pollfd pfd{m_desc, static_cast<short>(POLLOUT | (m_pending.empty() ? 0 : POLLIN)), 0};
+		m_metrics.Add(Counter_e::SYSCALLS);
+		if (-1 == poll(&pfd, 1, -1))
+		{
+			if (errno == EINTR)
 			{
-				if (errno == EINTR)
-				{
-					Log("EINTR is received.Try again read message");
-					continue;
-				}
-				return ErrorHandlingExceptEINTR(false);
+				m_metrics.Add(Counter_e::EINTR_RETRIES);
+				continue;
 			}
-			else
+			return ErrorHandlingExceptEINTR(true);
+		}
+		if (pfd.revents & (POLLOUT | POLLERR | POLLHUP)) return Res_e::SUCCESS;
+	}
+}
+
+Client::Res_e Client::WaitZeroCopyCompletions()
+{
+	//request buffer may be reused by caller only after kernel releases all its pages
+	while (m_tcp_zerocopy_completed != m_tcp_zerocopy_sent)
+	{
+		char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in))];
+		msghdr hdr{};
+		hdr.msg_control = control;
+		hdr.msg_controllen = sizeof(control);
+		m_metrics.Add(Counter_e::SYSCALLS);
+		if (-1 == recvmsg(m_desc, &hdr, MSG_ERRQUEUE))
+		{
+			if (errno == EINTR)
 			{
-				Log("Socket ", m_desc, " read ", read_bytes, " bytes");	
-				m_last_received_answer.append(buffer, read_bytes);
+				m_metrics.Add(Counter_e::EINTR_RETRIES);
+				continue;
 			}
-			
-			if ('\n' == m_last_received_answer.back())
+			if (errno == EAGAIN or errno == EWOULDBLOCK)
 			{
-				if (isdigit(m_last_received_answer[0])) {
-					m_last_received_answer[m_last_received_answer.rfind('\t')] = '\n';
-				}
-				break;
+				//error queue readiness is always reported as POLLERR
+				pollfd pfd{m_desc, 0, 0};
+				m_metrics.Add(Counter_e::SYSCALLS);
+				if (-1 == poll(&pfd, 1, -1) and errno != EINTR) { return ErrorHandlingExceptEINTR(false); }
+				continue;
+			}
+			return ErrorHandlingExceptEINTR(false);
+		}
+		for (cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm))
+		{
+			if (not ((cm->cmsg_level == SOL_IP and cm->cmsg_type == IP_RECVERR))) continue;
+			sock_extended_err const* err = reinterpret_cast<sock_extended_err const*>(CMSG_DATA(cm));
+			if (err->ee_errno != 0 or err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+			//notifications are coalesced into range [ee_info, ee_data]
+			m_tcp_zerocopy_completed += err->ee_data - err->ee_info + 1;
+			if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				Log("Socket ", m_desc, " zero copy send fell back to copying");
 			}
 		}
-		//remove '\n' because it does not present in original request
-		m_last_received_answer.pop_back();
 	}
-	else
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::RecvTcp(char* dst, std::size_t size, bool wait, std::size_t& read_bytes)
+{
+	while(1)
 	{
-		//UDP_PACKET_BEGIN(12 bytes) + PACKETS_QTY(2 bytes) + PACKET_NUMBER(2 bytes) + PACKET_SIZE(2 bytes)
-		uint16_t constexpr packet_size = 64;
-		uint16_t packets_qty = msg.size()/(packet_size - UDP_PACKET_HEADER_SIZE);
-		uint16_t ost = msg.size()%(packet_size - UDP_PACKET_HEADER_SIZE);
-		if (ost > 0){ ++packets_qty; }
-		Log("Packets qty is ", packets_qty);
-		size_t i = 0;
-		for (; i < packets_qty; )
+		m_metrics.Add(Counter_e::SYSCALLS);
+		ssize_t const res = recv(m_desc, dst, size, wait ? 0 : MSG_DONTWAIT);
+		if (-1 == res)
 		{
-			char wbuff[packet_size];
-			memcpy(wbuff, UDP_PACKET_BEGIN.data(), UDP_PACKET_BEGIN.size());
-			uint16_t packets_qty_net = htons(packets_qty);
-			memcpy(wbuff + UDP_PH_QTY_POS, &packets_qty_net, sizeof(packets_qty_net));
-			uint16_t seq_num_net = htons(i);
-			memcpy(wbuff + UDP_PH_SEQ_NUM_POS, &seq_num_net, sizeof(seq_num_net));
-			uint16_t ps_net = htons(packet_size);
-			memcpy(wbuff + UDP_PH_SIZE_POS, &ps_net, sizeof(ps_net));
-
-			size_t payload_len;
-			if ((packets_qty - 1) == i and ost > 0) payload_len = ost;
-			else payload_len = packet_size - UDP_PACKET_HEADER_SIZE;
-			
-			memcpy(&wbuff[UDP_PACKET_HEADER_SIZE], &msg[i*(packet_size - UDP_PACKET_HEADER_SIZE)], payload_len);
-			
-			socklen_t len = sizeof(m_server_sa);
-			int written_bytes = sendto(m_desc, wbuff, UDP_PACKET_HEADER_SIZE + payload_len, 0, (sockaddr const*)&m_server_sa, len);
-			if (written_bytes >= 0)
+			if (errno == EINTR)
 			{
-				Log("Socket ", m_desc, " write ", written_bytes, " bytes");
-				if (written_bytes != (UDP_PACKET_HEADER_SIZE + payload_len)) {
-					Log("Socket ", m_desc, " will repeat this packet sending");
-					continue;
-				}
-				++i;
+				Log("EINTR is received.Try again read message");
+				m_metrics.Add(Counter_e::EINTR_RETRIES);
+				continue;
 			}
-			else {
-				if (errno == EINTR)
-				{
-					Log("EINTR is received.Try again read message");
-					continue;
-				}
-				Log("Write failed: ", strerror(errno));
-				return Res_e::FAILURE;
+			if (not wait and (errno == EAGAIN or errno == EWOULDBLOCK)) { return Res_e::IN_PROGRESS; }
+			return ErrorHandlingExceptEINTR(false);
+		}
+		if (0 == res)
+		{
+			errno = ECONNRESET;
+			return ErrorHandlingExceptEINTR(false);
+		}
+		Log<LogLevel::TRACE>("Socket ", m_desc, " read ", res, " bytes");
+		m_metrics.Add(Counter_e::BYTES_IN, res);
+		read_bytes = res;
+		return Res_e::SUCCESS;
+	}
+}
+
+Client::Res_e Client::ReadTcpAnswer(std::string& answer, bool wait)
+{
+	if (Framing_e::LENGTH_PREFIXED == m_tcp_framing) return ReadTcpBinAnswer(answer, wait);
+	while(1) 
+	{ 
+		//bytes left from the previous read are scanned before the socket is read again
+		if (not m_tcp_rd_buffer.Empty())
+		{
+			char const* data = m_tcp_rd_buffer.Data();
+			char const* end = static_cast<char const*>(memchr(data, TCP_LINE_END, m_tcp_rd_buffer.Size()));
+			size_t const size = end ? end - data : m_tcp_rd_buffer.Size();
+			if (answer.size() + size > m_tcp_max_answer_size) return FailLongAnswer(answer.size() + size);
+			if (end)
+			{
+				//'\n' is not added because it does not present in original request
+				answer.append(data, size);
+				m_tcp_rd_buffer.Consume(size + 1);
+				return Res_e::SUCCESS;
 			}
+			answer.append(data, size);
+			m_tcp_rd_buffer.Consume(size);
 		}
 		
-		uint16_t rd_packets_qty;
-		char buffer [MAX_UDP_PACKET_SIZE];
-		vector<size_t> packet_numbers;
-		do
+		char* space = m_tcp_rd_buffer.Space();
+		size_t read_bytes;
+		if (auto const res = RecvTcp(space, m_tcp_rd_buffer.SpaceSize(), wait, read_bytes); Res_e::SUCCESS != res) { return res; }
+		m_tcp_rd_buffer.Commit(read_bytes);
+	}
+}
+
+Client::Res_e Client::ReadTcpBinAnswer(std::string& answer, bool wait)
+{
+	while(1)
+	{
+		//answer is sized by its header once and filled in place, it may take several calls without waiting
+		if (not m_tcp_answer_size_known and m_tcp_rd_buffer.Size() >= TCP_BIN_HEADER_SIZE)
 		{
-			socklen_t len = sizeof(m_server_sa);
-			int read_bytes = recvfrom(m_desc, buffer, MAX_UDP_PACKET_SIZE, 0, (sockaddr*)&m_server_sa, &len);
-			if (read_bytes > 0)
+			uint32_t size;
+			memcpy(&size, m_tcp_rd_buffer.Data(), sizeof(size));
+			m_tcp_rd_buffer.Consume(TCP_BIN_HEADER_SIZE);
+			size = ntohl(size);
+			//size is checked before allocation, so broken header can not take memory
+			if (size > m_tcp_max_answer_size) return FailLongAnswer(size);
+			answer.resize(size);
+			m_tcp_answer_filled = 0;
+			m_tcp_answer_size_known = true;
+		}
+		if (m_tcp_answer_size_known)
+		{
+			size_t const chunk = min(answer.size() - m_tcp_answer_filled, m_tcp_rd_buffer.Size());
+			memcpy(&answer[m_tcp_answer_filled], m_tcp_rd_buffer.Data(), chunk);
+			m_tcp_rd_buffer.Consume(chunk);
+			m_tcp_answer_filled += chunk;
+			if (m_tcp_answer_filled == answer.size())
+			{
+				m_tcp_answer_size_known = false;
+				return Res_e::SUCCESS;
+			}
+			if (answer.size() - m_tcp_answer_filled >= TCP_BIN_DIRECT_READ_SIZE)
 			{
-				Log("Socket ", m_desc, " read ", read_bytes, " bytes");
+				size_t read_bytes;
+				if (auto const res = RecvTcp(&answer[m_tcp_answer_filled], answer.size() - m_tcp_answer_filled, wait, read_bytes); Res_e::SUCCESS != res) { return res; }
+				m_tcp_answer_filled += read_bytes;
+				continue;
+			}
+		}
+		
+		char* space = m_tcp_rd_buffer.Space();
+		size_t read_bytes;
+		if (auto const res = RecvTcp(space, m_tcp_rd_buffer.SpaceSize(), wait, read_bytes); Res_e::SUCCESS != res) { return res; }
+		m_tcp_rd_buffer.Commit(read_bytes);
+	}
+}
 
-				if (read_bytes < UDP_PACKET_HEADER_SIZE)
-				{
-					Log("Packet is not from protey client");
-					continue;
-				}
-				if (string_view{buffer, UDP_PACKET_BEGIN.size()} != UDP_PACKET_BEGIN)
-				{
-					Log("Packet is not from protey server");
-					continue;
-				}
-				
-				uint16_t rd_packet_number;
-				memcpy(&rd_packet_number, buffer + UDP_PH_SEQ_NUM_POS, sizeof(rd_packet_number));
-				rd_packet_number = ntohs(rd_packet_number);
-				Log("Packet number is ", rd_packet_number);
-				
-				if (find(packet_numbers.begin(), packet_numbers.end(), rd_packet_number) != packet_numbers.end())
-				{
-					Log("Duplicated packet");
-					continue;
-				}
-				
-				if (packet_numbers.empty())
-				{
-					memcpy(&rd_packets_qty, buffer + UDP_PH_QTY_POS, sizeof(rd_packets_qty));
-					rd_packets_qty = ntohs(rd_packets_qty);
-					Log("Packet qty is ", rd_packets_qty);
-					m_last_received_answer.resize(rd_packets_qty*(packet_size - UDP_PACKET_HEADER_SIZE));
-				}
-				
-				if (rd_packet_number != (rd_packets_qty - 1))//not the last packet of message
-				{
-					if (read_bytes != packet_size)
-					{
-						Log("Damaged packet");
-						continue;
-					}
-				}
-				else
+Client::Res_e Client::FailLongAnswer(std::size_t size)
+{
+	Log<LogLevel::ERROR>("Answer of ", size, " bytes is longer than ", m_tcp_max_answer_size, " bytes");
+	OnConnectionBroken();
+	return Res_e::FAILURE;
+}
+
+void Client::ConvertTcpAnswer(std::string& answer)
+{
+	if (not answer.empty() and isdigit(answer[0]))
+	{
+		if (auto const pos = answer.rfind('\t'); pos != string::npos) {
+			answer[pos] = '\n';
+		}
+	}
+}
+
+Client::Res_e Client::Submit(std::string_view msg, Callback callback)
+{
+	if (auto const res = Reconnect(); Res_e::SUCCESS != res) { return res; }
+	if (IPPROTO_TCP != m_proto)
+	{
+		Log<LogLevel::WARNING>("Pipelined requests are supported only for TCP");
+		return Res_e::NOT_SUPPORTED;
+	}
+	if (msg.empty()) return Res_e::NO_DATA_TO_SEND;
+	return SubmitChunks(&msg, &callback, 1);
+}
+
+Client::Res_e Client::SubmitBatch(std::string_view const* msgs, Callback* callbacks, std::size_t qty)
+{
+	auto const fail = [&](Res_e res)
+	{
+		for (size_t i = 0; i < qty; ++i) { if (callbacks[i]) { callbacks[i](res, {}); } }
+		return res;
+	};
+	if (auto const res = Reconnect(); Res_e::SUCCESS != res) { return fail(res); }
+	if (IPPROTO_TCP != m_proto)
+	{
+		Log<LogLevel::WARNING>("Pipelined requests are supported only for TCP");
+		return fail(Res_e::NOT_SUPPORTED);
+	}
+	return SubmitChunks(msgs, callbacks, qty);
+}
+
+Client::Res_e Client::SubmitChunks(std::string_view const* msgs, Callback* callbacks, std::size_t qty)
+{
+	//every callback is called once, requests which were not written get the error
+	auto const fail = [&](Res_e res, size_t from)
+	{
+		for (size_t i = from; i < qty; ++i) { if (callbacks[i]) { callbacks[i](res, {}); } }
+		return res;
+	};
+	for (size_t first = 0; first < qty;)
+	{
+		//backpressure: no more than m_window requests wait for answer, batch larger than window is written by parts
+		size_t const chunk = min(qty - first, m_window);
+		while (m_pending.size() + chunk > m_window)
+		{
+			if (auto const res = CompleteNext(true); Res_e::SUCCESS != res) { return fail(res, first); }
+		}
+		Log("Socket ", m_desc, " submits ", chunk, " requests, ", m_pending.size(), " requests are in flight");
+		m_tcp_wr_iovs.clear();
+		//headers are not moved after iovecs point to them
+		m_tcp_wr_headers.resize(chunk);
+		for (size_t i = 0; i < chunk; ++i)
+		{
+			iovec iov{const_cast<char*>(msgs[first + i].data()), msgs[first + i].size()};
+			if (not AppendTcpRequest(&iov, 1, m_tcp_wr_headers[i])) { return fail(Res_e::FAILURE, first); }
+		}
+		auto const now = chrono::steady_clock::now();
+		for (size_t i = first; i < first + chunk; ++i) { m_pending.push_back({move(callbacks[i]), now}); }
+		first += chunk;
+		//caller buffers are not kept after Submit returns, so zero copy is not used here
+		if (auto const res = WriteTcpIovs(false, true); Res_e::SUCCESS != res)
+		{
+			FailPending(res);
+			return fail(res, first);
+		}
+	}
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::Poll()
+{
+	while (not m_pending.empty())
+	{
+		auto const res = CompleteNext(false);
+		if (Res_e::IN_PROGRESS == res) break;
+		if (Res_e::SUCCESS != res) return res;
+	}
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::Flush()
+{
+	while (not m_pending.empty())
+	{
+		if (auto const res = CompleteNext(true); Res_e::SUCCESS != res) { return res; }
+	}
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::CompleteNext(bool wait)
+{
+	//answer is accumulated between calls until '\n' is received
+	auto const res = ReadTcpAnswer(m_pending_answer, wait);
+	if (Res_e::IN_PROGRESS == res) return res;
+	if (Res_e::SUCCESS != res)
+	{
+		FailPending(res);
+		return res;
+	}
+	if (Framing_e::LINE == m_tcp_framing) { ConvertTcpAnswer(m_pending_answer); }
+	//answers come in the order of requests
+	auto pending = move(m_pending.front());
+	m_pending.pop_front();
+	RecordRequest(Res_e::SUCCESS, pending.submitted);
+	if (pending.callback) { pending.callback(Res_e::SUCCESS, m_pending_answer); }
+	m_pending_answer.clear();
+	return Res_e::SUCCESS;
+}
+
+void Client::FailPending(Res_e res)
+{
+	Log<LogLevel::WARNING>("Socket ", m_desc, " drops ", m_pending.size(), " requests waiting for answer");
+	auto pending = move(m_pending);
+	m_pending.clear();
+	m_pending_answer.clear();
+	for (auto& request : pending)
+	{
+		RecordRequest(res, request.submitted);
+		if (request.callback) { request.callback(res, {}); }
+	}
+}
+
+Client::Res_e Client::SendMsg(std::string_view msg)
+{
+	iovec iov{const_cast<char*>(msg.data()), msg.size()};
+	return SendMsg(&iov, 1, m_last_received_answer);
+}
+
+Client::Res_e Client::SendMsg(iovec const* iov, std::size_t iovcnt)
+{
+	return SendMsg(iov, iovcnt, m_last_received_answer);
+}
+
+Client::Res_e Client::SendMsg(std::string_view msg, std::string& answer)
+{
+	iovec iov{const_cast<char*>(msg.data()), msg.size()};
+	return SendMsg(&iov, 1, answer);
+}
+
+Client::Res_e Client::SendMsg(iovec const* iov, std::size_t iovcnt, std::string& answer)
+{
+	if (auto const res = Reconnect(); Res_e::SUCCESS != res) { return res; }
+	size_t msg_size = 0;
+	for (size_t i = 0; i < iovcnt; ++i) { msg_size += iov[i].iov_len; }
+	if (0 == msg_size) return Res_e::NO_DATA_TO_SEND;
+	Log("Socket ", m_desc, " starts sending request with size ", msg_size, " bytes");
+	
+	auto const begin = chrono::steady_clock::now();
+	auto const res = Exchange(iov, iovcnt, answer);
+	RecordRequest(res, begin);
+	return res;
+}
+
+void Client::RecordRequest(Res_e res, std::chrono::steady_clock::time_point begin)
+{
+	m_metrics.Add(Counter_e::REQUESTS);
+	if (Res_e::SUCCESS != res)
+	{
+		m_metrics.Add(Counter_e::FAILED_REQUESTS);
+		return;
+	}
+	m_metrics.AddRtt(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+}
+
+Client::Res_e Client::Exchange(iovec const* iov, std::size_t iovcnt, std::string& answer)
+{
+	if (IPPROTO_TCP == m_proto)
+	{
+		//answers of already submitted requests come first on the connection
+		if (auto const res = Flush(); Res_e::SUCCESS != res) { return res; }
+		if (auto const res = WriteTcpRequest(iov, iovcnt, true); Res_e::SUCCESS != res) { return res; }
+		answer.clear();
+		if (auto const res = ReadTcpAnswer(answer, true); Res_e::SUCCESS != res) { return res; }
+		if (Framing_e::LINE == m_tcp_framing) { ConvertTcpAnswer(answer); }
+		if (auto const res = WaitZeroCopyCompletions(); Res_e::SUCCESS != res) { return res; }
+	}
+	else
+	{
+		//fragments are cut from contiguous message, scattered one is gathered first
+		string_view msg{static_cast<char const*>(iov[0].iov_base), iov[0].iov_len};
+		if (iovcnt > 1)
+		{
+			m_udp_wr_gather.clear();
+			for (size_t i = 0; i < iovcnt; ++i) { m_udp_wr_gather.append(static_cast<char const*>(iov[i].iov_base), iov[i].iov_len); }
+			msg = m_udp_wr_gather;
+		}
+		if (auto const res = ExchangeUdp(msg, answer); Res_e::SUCCESS != res) { return res; }
+	}
+	
+	Log<LogLevel::TRACE>("Answer:\n", answer);
+	
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::SendUdpRequest(std::string_view msg, uint32_t msg_id)
+{
+	//connected socket already knows destination
+	m_udp_fragmenter.Build(msg, m_udp_packet_size, msg_id, m_udp_gso, m_udp_connected ? nullptr : &m_server_sa);
+	Log<LogLevel::TRACE>("Packets qty is ", m_udp_fragmenter.GetPacketsQty());
+	while (not m_udp_fragmenter.IsSent())
+	{
+		auto const repeated = m_udp_fragmenter.GetRepeated();
+		auto const sent_bytes = m_udp_fragmenter.GetSentBytes();
+		m_metrics.Add(Counter_e::SYSCALLS);
+		int written_msgs = m_udp_fragmenter.Send(m_desc, 0);
+		if (-1 == written_msgs)
+		{
+			if (errno == EINTR)
+			{
+				Log("EINTR is received.Try again send message");
+				m_metrics.Add(Counter_e::EINTR_RETRIES);
+				continue;
+			}
+			Log<LogLevel::ERROR>("Write failed: ", strerror(errno));
+			if (errno == EMSGSIZE)
+			{
+				//path MTU became less, next message will be fragmented by new size
+				uint16_t const packet_size = UdpFragmenter::DiscoverPacketSize(m_server_sa, m_udp_cfg_packet_size);
+				if (packet_size != m_udp_packet_size)
 				{
-					m_last_received_answer.resize((rd_packets_qty - 1)*(packet_size - UDP_PACKET_HEADER_SIZE) + read_bytes - UDP_PACKET_HEADER_SIZE);
+					m_udp_packet_size = packet_size;
+					Log<LogLevel::WARNING>("UDP packet size is changed to ", m_udp_packet_size);
+					if (m_udp_gso) { SetUdpGsoSize(); }
 				}
-				packet_numbers.push_back(rd_packet_number);
-				memcpy(&m_last_received_answer[rd_packet_number*(packet_size - UDP_PACKET_HEADER_SIZE)], &buffer[UDP_PACKET_HEADER_SIZE], read_bytes - UDP_PACKET_HEADER_SIZE);
 			}
-			else if (0 == read_bytes)
+			return Res_e::FAILURE;
+		}
+		Log<LogLevel::TRACE>("Socket ", m_desc, " write ", written_msgs, " messages");
+		m_metrics.Add(Counter_e::BYTES_OUT, m_udp_fragmenter.GetSentBytes() - sent_bytes);
+		if (m_udp_fragmenter.GetRepeated() != repeated) {
+			Log<LogLevel::WARNING>("Socket ", m_desc, " will repeat this packet sending");
+			m_metrics.Add(Counter_e::PARTIAL_WRITES);
+		}
+	}
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::AskUdpResend(uint32_t msg_id)
+{
+	UdpFragmenter::BuildResend(m_udp_resend_packet, msg_id, m_udp_missing, m_udp_packet_size);
+	while (1)
+	{
+		m_metrics.Add(Counter_e::SYSCALLS);
+		if (-1 != sendto(m_desc, m_udp_resend_packet.data(), m_udp_resend_packet.size(), 0,
+			m_udp_connected ? nullptr : (sockaddr const*)&m_server_sa, m_udp_connected ? 0 : sizeof(m_server_sa))) break;
+		if (errno != EINTR)
+		{
+			Log<LogLevel::ERROR>("Write failed: ", strerror(errno));
+			return Res_e::FAILURE;
+		}
+		m_metrics.Add(Counter_e::EINTR_RETRIES);
+	}
+	m_metrics.Add(Counter_e::BYTES_OUT, m_udp_resend_packet.size());
+	return Res_e::SUCCESS;
+}
+
+Client::Res_e Client::ExchangeUdp(std::string_view msg, std::string& answer)
+{
+	auto const deadline = m_udp_timeout.count() > 0 ? chrono::steady_clock::now() + m_udp_timeout : chrono::steady_clock::time_point::max();
+	//without MESSAGE_ID late fragments of previous timed out request would be taken for answer of this one
+	if (not m_udp_has_msg_id)
+	{
+		if (auto const dropped = m_udp_recv.Drop(m_desc); dropped > 0) { Log("Socket ", m_desc, " drops ", dropped, " late packets"); }
+	}
+	
+	uint32_t const msg_id = ++m_udp_msg_id;
+	m_udp_reassembler.Expect(msg_id, answer);
+	if (auto const res = SendUdpRequest(msg, msg_id); Res_e::SUCCESS != res)
+	{
+		m_udp_reassembler.Forget(msg_id);
+		return res;
+	}
+	
+	UdpRequestTimer timer;
+	timer.Start(deadline, m_udp_has_msg_id);
+	timer.OnSent(chrono::steady_clock::now(), m_udp_rto);
+	bool is_readable = false;
+	bool is_completed = false;
+	while (not is_completed)
+	{
+		if (not is_readable)
+		{
+			auto const now = chrono::steady_clock::now();
+			auto const action = timer.OnTimer(now, m_udp_rto, m_udp_reassembler, msg_id, m_udp_missing, UdpResendMaxQty(m_udp_packet_size));
+			if (UdpRequestTimer::Action_e::TIMEOUT == action)
 			{
-				Log("Socket read 0 bytes");
-				continue;
+				Log<LogLevel::WARNING>("Socket ", m_desc, " did not receive answer of message ", msg_id, " in time");
+				m_udp_reassembler.Forget(msg_id);
+				m_metrics.Add(Counter_e::TIMEOUTS);
+				return Res_e::TIMEOUT;
 			}
-			else
+			if (UdpRequestTimer::Action_e::WAIT != action)
 			{
-				if (errno == EINTR)
+				bool const is_resend = UdpRequestTimer::Action_e::ASK_RESEND == action;
+				Log("Socket ", m_desc, is_resend ? " asks to resend fragments of message " : " sends again message ", msg_id);
+				auto const res = is_resend ? AskUdpResend(msg_id) : SendUdpRequest(msg, msg_id);
+				if (Res_e::SUCCESS != res)
 				{
-					Log("EINTR is received.Try again read message");
-					continue;
+					m_udp_reassembler.Forget(msg_id);
+					return res;
 				}
+				m_metrics.Add(is_resend ? Counter_e::UDP_RESEND_REQUESTS : Counter_e::UDP_RETRANSMITS);
+				if (not is_resend) { timer.OnSent(now, m_udp_rto); }
+				continue;
+			}
+			auto const wait = chrono::duration_cast<chrono::nanoseconds>(timer.GetNext() - now).count();
+			timespec const timeout{static_cast<time_t>(wait/1000000000), static_cast<long>(wait%1000000000)};
+			pollfd pfd{m_desc, POLLIN, 0};
+			m_metrics.Add(Counter_e::SYSCALLS);
+			int const ready = ppoll(&pfd, 1, &timeout, nullptr);
+			if (-1 == ready and errno != EINTR)
+			{
+				m_udp_reassembler.Forget(msg_id);
 				return ErrorHandlingExceptEINTR(false);
 			}
-		}while(rd_packets_qty != packet_numbers.size());
+			is_readable = ready > 0;
+			continue;
+		}
+		
+		m_metrics.Add(Counter_e::SYSCALLS);
+		int const read_packets = m_udp_recv.Recv(m_desc);
+		if (-1 == read_packets)
+		{
+			if (errno == EINTR)
+			{
+				Log("EINTR is received.Try again read message");
+				m_metrics.Add(Counter_e::EINTR_RETRIES);
+				continue;
+			}
+			if (errno == EAGAIN or errno == EWOULDBLOCK)
+			{
+				is_readable = false;
+				continue;
+			}
+			m_udp_reassembler.Forget(msg_id);
+			return ErrorHandlingExceptEINTR(false);
+		}
+		
+		//short batch means socket is drained, so the next read is preceded by waiting
+		is_readable = static_cast<size_t>(read_packets) == UDP_MMSG_BATCH_SIZE;
+		bool is_progress = false;
+		for (int k = 0; k < read_packets; ++k)
+		{
+			size_t const read_bytes = m_udp_recv.GetSize(k);
+			Log<LogLevel::TRACE>("Socket ", m_desc, " read ", read_bytes, " bytes");
+			m_metrics.Add(Counter_e::BYTES_IN, read_bytes);
+			if (m_udp_recv.IsTruncated(k))
+			{
+				Log<LogLevel::WARNING>("Damaged packet");
+				m_metrics.Add(Counter_e::DAMAGED_FRAGMENTS);
+				continue;
+			}
+			//connected socket receives from server only
+			sockaddr_in const& peer = m_udp_recv.GetPeer(k);
+			if (not m_udp_connected and (peer.sin_addr.s_addr != m_server_sa.sin_addr.s_addr or peer.sin_port != m_server_sa.sin_port))
+			{
+				Log<LogLevel::WARNING>("Packet is not from server");
+				m_metrics.Add(Counter_e::FOREIGN_FRAGMENTS);
+				continue;
+			}
+			
+			uint32_t rd_msg_id;
+			switch (m_udp_reassembler.Add(m_udp_recv.GetData(k), read_bytes, rd_msg_id))
+			{
+			case UdpReassembler::Res_e::FRAGMENT_ADDED:
+				is_progress = true;
+				break;
+			case UdpReassembler::Res_e::MESSAGE_COMPLETED:
+				if (rd_msg_id == msg_id) { is_completed = is_progress = true; }
+				break;
+			case UdpReassembler::Res_e::DUPLICATED:
+				Log("Duplicated packet");
+				m_metrics.Add(Counter_e::DUPLICATED_FRAGMENTS);
+				break;
+			case UdpReassembler::Res_e::DAMAGED:
+				Log<LogLevel::WARNING>("Damaged packet");
+				m_metrics.Add(Counter_e::DAMAGED_FRAGMENTS);
+				break;
+			case UdpReassembler::Res_e::FOREIGN:
+				Log("Packet is not from protey server or belongs to another message");
+				m_metrics.Add(Counter_e::FOREIGN_FRAGMENTS);
+				break;
+			}
+		}
+		if (is_progress) { timer.OnProgress(chrono::steady_clock::now(), m_udp_rto); }
 	}
-	
-	Log("Answer:\n", m_last_received_answer);
-	
 	return Res_e::SUCCESS;
 }
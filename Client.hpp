@@ -1,12 +1,30 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <string_view>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <random>
+#include <chrono>
+#include "UdpReassembler.hpp"
+#include "UdpFragmenter.hpp"
+#include "UdpPacket.hpp"
+#include "RecvBuffer.hpp"
+#include "TcpPacket.hpp"
+#include "ClientMetrics.hpp"
+#include "RtoEstimator.hpp"
+#include "UdpRecvBatch.hpp"
 
 class Client
 {
 	static constexpr uint8_t MAX_IPv4_SIZE = 15;
-	static constexpr std::size_t MAX_UDP_PACKET_SIZE = 1024;
+	static constexpr uint8_t MAX_PORT_SIZE = 5;
+	static constexpr std::chrono::milliseconds MIN_RECONNECT_DELAY{10};
+	static constexpr std::chrono::milliseconds MAX_RECONNECT_DELAY{5000};
 public:
 	enum class Res_e : uint8_t
 	{
@@ -20,20 +38,180 @@ public:
 		FAILURE,
 		CONNECTION_BROKEN,
 		NO_DATA_TO_SEND,
+		NOT_SUPPORTED,
+		WINDOW_IS_FULL,
+		IN_PROGRESS,
+		TIMEOUT,
+		RECONNECTING,
 		SUCCESS
 	};
+	//answer is valid only during the call
+	using Callback = std::function<void(Res_e res, std::string_view answer)>;
+	
 	~Client();
 	Res_e Start(std::string_view params);
 	Res_e Start();
-	Res_e SendMsg(std::string const& msg);
+	//TCP connect fails with TIMEOUT if it is not completed in this time.Applied by Start()
+	void SetConnectTimeout(std::chrono::milliseconds timeout) { m_connect_timeout = timeout; }
+	//"TCP,IPv4,PORT" of server which connection is kept ready by Start() and replaces broken connection at once,
+	//it may be the same server.Its framing has to match the one of Start(params)
+	Res_e SetStandbyServer(std::string_view params);
+	//broken TCP connection is restored in background by non-blocking connects with jittered exponential backoff,
+	//requests fail with RECONNECTING meanwhile instead of waiting
+	void SetReconnect(bool enable) { m_reconnect = enable; }
+	//advances reconnect without sending anything, SUCCESS once connected
+	Res_e Reconnect();
+	//Start which does not wait for TCP connect, it is completed by Reconnect() and requests meanwhile
+	//like reconnect of broken connection.RECONNECTING until then
+	Res_e StartInBackground(std::string_view params);
+	//Reconnect() does not start the next connect before this time, connect in progress is checked by every call
+	std::chrono::steady_clock::time_point GetReconnectTime() const { return m_reconnect_at; }
+	Res_e SendMsg(std::string_view msg);
+	//request is concatenation of iov buffers
+	Res_e SendMsg(iovec const* iov, std::size_t iovcnt);
+	//answer is written into caller's string instead of GetLastReceivedAnswer(),
+	//its capacity is reused so requests do not allocate once it has grown to the answer size
+	Res_e SendMsg(std::string_view msg, std::string& answer);
+	Res_e SendMsg(iovec const* iov, std::size_t iovcnt, std::string& answer);
 	std::string const& GetLastReceivedAnswer() const { return m_last_received_answer; }
+	//Pipelined TCP requests.Submit does not wait for answer unless window is full,
+	//callbacks are called from Submit/Poll/Flush/SendMsg in the order of requests.
+	//Answers are read while requests are written, so callbacks must not submit requests themselves.
+	//Once connection and arguments are checked, callback is called even if Submit fails
+	Res_e Submit(std::string_view msg, Callback callback);
+	//several requests are written by one call, every callback is called once even if the batch fails
+	Res_e SubmitBatch(std::string_view const* msgs, Callback* callbacks, std::size_t qty);
+	//completes requests which answers are already received, does not block
+	Res_e Poll();
+	//waits for answers of all submitted requests
+	Res_e Flush();
+	void SetWindow(std::size_t window) { m_window = window > 0 ? window : 1; }
+	std::size_t GetInFlight() const { return m_pending.size(); }
+	//socket to wait for readiness together with other descriptors, I/O must be done through Client
+	int GetDesc() const { return m_desc; }
+	
+	enum class Framing_e : uint8_t
+	{
+		LINE,           //"TCP": '\n' terminated messages
+		LENGTH_PREFIXED //"TCPBIN": binary length header, payload is not scanned
+	};
+	//"PROTO,IPv4,PORT" parsing shared with other connection owners,
+	//TCPBIN is accepted only if caller supports framing
+	static Res_e ParseParams(std::string_view params, int& proto, sockaddr_in& server_sa, Framing_e* framing = nullptr);
+	//digit prefixed answer has its last '\t' replaced by '\n'
+	static void ConvertTcpAnswer(std::string& answer);
+	//UDP datagram size with header, default is UDP_LEGACY_PACKET_SIZE understood by every server.
+	//0 means the largest size allowed by path MTU, server has to accept such datagrams.Applied by Start()
+	void SetUdpPacketSize(uint16_t size) { m_udp_cfg_packet_size = size; }
+	//let kernel split fragments of a message into datagrams(UDP_SEGMENT).Applied by Start()
+	void SetUdpGso(bool enable) { m_udp_gso = enable; }
+	uint16_t GetUdpPacketSize() const { return m_udp_packet_size; }
+	//fragments carry MESSAGE_ID, so late answers to repeated requests are recognized and missing
+	//fragments may be asked by resend request.Without it lost request is not repeated.
+	//Server has to support it.Applied by Start()
+	void SetUdpMessageId(bool enable) { m_udp_has_msg_id = enable; }
+	//fragments of longer UDP answers are dropped as damaged, so request ends by timeout
+	void SetUdpMaxAnswerSize(std::size_t size) { m_udp_reassembler.SetMaxAnswerSize(size); }
+	//connect UDP socket to server: kernel skips route lookup for every datagram and drops datagrams
+	//of other senders.Without it they are dropped by source address check.Applied by Start()
+	void SetUdpConnected(bool enable) { m_udp_connected = enable; }
+	//TCP answer longer than this fails with FAILURE and closes connection, as the rest of stream can not be trusted
+	void SetTcpMaxAnswerSize(std::size_t size) { m_tcp_max_answer_size = size; }
+	//TCP requests of this size and more are sent with MSG_ZEROCOPY by SendMsg, 0 disables it.Applied by Start()
+	void SetTcpZeroCopyThreshold(std::size_t size) { m_tcp_zerocopy_threshold = size; }
+	//UDP SendMsg returns TIMEOUT if answer is not completed in this time, 0 means no limit.
+	//Lost fragments are recovered by retransmission with adaptive timeout until then if MESSAGE_ID is on
+	void SetUdpTimeout(std::chrono::milliseconds timeout) { m_udp_timeout = timeout; }
+	//counters since creation, snapshot may be taken from any thread
+	ClientMetrics const& GetMetrics() const { return m_metrics; }
 private:
 	Res_e ValidateInputParams(std::string_view params);
+	int CreateSocket(int type, Res_e& res);
+	//returns socket with connect in progress or -1
+	int StartConnect(sockaddr_in const& sa, Res_e& res);
+	Res_e FinishConnect(int desc, std::chrono::milliseconds timeout);
+	void UseConnection(int desc);
+	bool TakeStandby();
+	void OnConnectionBroken();
+	void ScheduleReconnect(std::chrono::steady_clock::time_point now);
+	void StopReconnect();
+	//sends request and waits for its answer
+	Res_e Exchange(iovec const* iov, std::size_t iovcnt, std::string& answer);
+	void RecordRequest(Res_e res, std::chrono::steady_clock::time_point begin);
+	Res_e ExchangeUdp(std::string_view msg, std::string& answer);
+	Res_e SendUdpRequest(std::string_view msg, uint32_t msg_id);
+	//kernel cuts GSO datagrams by m_udp_packet_size, GSO is disabled if socket does not accept it
+	void SetUdpGsoSize();
+	//asks server to resend fragments of answer listed in m_udp_missing
+	Res_e AskUdpResend(uint32_t msg_id);
+	Res_e WriteTcpRequest(iovec const* iov, std::size_t iovcnt, bool zerocopy_allowed);
+	//adds framed request to m_tcp_wr_iovs, header must not move until it is written
+	bool AppendTcpRequest(iovec const* iov, std::size_t iovcnt, uint32_t& header);
+	//pipelined write does not block, answers are completed while socket is not writable
+	Res_e WriteTcpIovs(bool zerocopy_allowed, bool is_pipelined);
+	Res_e WaitWritable();
+	//requests are added to m_pending before they are written, so their answers may be completed meanwhile
+	Res_e SubmitChunks(std::string_view const* msgs, Callback* callbacks, std::size_t qty);
+	Res_e WaitZeroCopyCompletions();
+	Res_e ReadTcpAnswer(std::string& answer, bool wait);
+	Res_e ReadTcpBinAnswer(std::string& answer, bool wait);
+	Res_e FailLongAnswer(std::size_t size);
+	//IN_PROGRESS if there is nothing to read and wait is false
+	Res_e RecvTcp(char* dst, std::size_t size, bool wait, std::size_t& read_bytes);
+	Res_e CompleteNext(bool wait);
+	void FailPending(Res_e res);
 	Res_e ErrorHandlingExceptEINTR(bool IsWrite);
 	
 	int         m_proto;
+	Framing_e   m_tcp_framing{Framing_e::LINE};
 	int         m_desc{-1};
 	sockaddr_in m_server_sa;
 	bool        m_is_started{false};
+	std::chrono::milliseconds m_connect_timeout{3000};
+	bool        m_has_standby{false};
+	sockaddr_in m_standby_sa;
+	Framing_e   m_standby_framing{Framing_e::LINE};
+	int         m_standby_desc{-1};
+	bool        m_reconnect{false};
+	bool        m_is_reconnecting{false};
+	int         m_reconnect_desc{-1};
+	std::chrono::steady_clock::time_point m_reconnect_at;
+	std::chrono::steady_clock::time_point m_reconnect_started;
+	std::chrono::milliseconds             m_reconnect_delay{MIN_RECONNECT_DELAY};
+	std::minstd_rand                      m_random{std::random_device{}()};
+	uint16_t    m_udp_cfg_packet_size{UDP_LEGACY_PACKET_SIZE};
+	uint16_t    m_udp_packet_size{0};
+	bool        m_udp_gso{false};
+	bool        m_udp_connected{false};
+	bool        m_udp_has_msg_id{false};
+	uint32_t    m_udp_msg_id{0};
+	std::chrono::milliseconds m_udp_timeout{5000};
+	RtoEstimator              m_udp_rto;
+	UdpReassembler m_udp_reassembler;
+	RecvBuffer     m_tcp_rd_buffer;
+	//TCPBIN answer being read
+	bool           m_tcp_answer_size_known{false};
+	std::size_t    m_tcp_answer_filled{0};
+	std::size_t    m_tcp_max_answer_size{TCP_DEFAULT_MAX_ANSWER_SIZE};
+	std::size_t          m_window{64};
+	struct Pending
+	{
+		Callback                              callback;
+		std::chrono::steady_clock::time_point submitted;
+	};
+	std::deque<Pending>  m_pending;
+	std::string          m_pending_answer;
 	std::string m_last_received_answer;
+	//UDP fragments storage reused between SendMsg calls
+	UdpFragmenter        m_udp_fragmenter;
+	UdpRecvBatch         m_udp_recv;
+	std::string          m_udp_wr_gather;
+	std::vector<uint16_t> m_udp_missing;
+	std::vector<char>    m_udp_resend_packet;
+	std::vector<iovec>   m_tcp_wr_iovs;
+	std::vector<uint32_t> m_tcp_wr_headers;
+	std::size_t          m_tcp_zerocopy_threshold{0};
+	uint32_t             m_tcp_zerocopy_sent{0};
+	uint32_t             m_tcp_zerocopy_completed{0};
+	ClientMetrics        m_metrics;
 };
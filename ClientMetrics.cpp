@@ -0,0 +1,122 @@
+#include <algorithm>
+#include "ClientMetrics.hpp"
+
+using namespace std;
+
+const char* ClientMetrics::GetName(Counter_e counter)
+{
+	switch (counter)
+	{
+	case Counter_e::REQUESTS:             return "requests";
+	case Counter_e::FAILED_REQUESTS:      return "failed_requests";
+	case Counter_e::SYSCALLS:             return "syscalls";
+	case Counter_e::EINTR_RETRIES:        return "eintr_retries";
+	case Counter_e::PARTIAL_WRITES:       return "partial_writes";
+	case Counter_e::DUPLICATED_FRAGMENTS: return "duplicated_fragments";
+	case Counter_e::DAMAGED_FRAGMENTS:    return "damaged_fragments";
+	case Counter_e::FOREIGN_FRAGMENTS:    return "foreign_fragments";
+	case Counter_e::UDP_RETRANSMITS:      return "udp_retransmits";
+	case Counter_e::UDP_RESEND_REQUESTS:  return "udp_resend_requests";
+	case Counter_e::TIMEOUTS:             return "timeouts";
+	case Counter_e::BYTES_OUT:            return "bytes_out";
+	case Counter_e::BYTES_IN:             return "bytes_in";
+	case Counter_e::QTY:                  break;
+	}
+	return "unknown";
+}
+
+size_t ClientMetrics::BucketIndex(uint64_t value)
+{
+	//values less than SUB_BUCKETS_QTY have own buckets, the rest are split by highest bit and next SUB_BUCKETS_BITS bits
+	if (value < SUB_BUCKETS_QTY) return value;
+	unsigned const high_bit = 63 - __builtin_clzll(value);
+	size_t const sub_bucket = (value >> (high_bit - SUB_BUCKETS_BITS)) & (SUB_BUCKETS_QTY - 1);
+	return (high_bit - SUB_BUCKETS_BITS + 1)*SUB_BUCKETS_QTY + sub_bucket;
+}
+
+uint64_t ClientMetrics::BucketUpperBound(size_t index)
+{
+	if (index < SUB_BUCKETS_QTY) return index;
+	unsigned const high_bit = index/SUB_BUCKETS_QTY + SUB_BUCKETS_BITS - 1;
+	uint64_t const width = uint64_t{1} << (high_bit - SUB_BUCKETS_BITS);
+	return (SUB_BUCKETS_QTY + index%SUB_BUCKETS_QTY)*width + (width - 1);
+}
+
+ClientMetrics::Snapshot ClientMetrics::GetSnapshot() const
+{
+	Snapshot s;
+	for (size_t i = 0; i < COUNTERS_QTY; ++i) { s.counters[i] = m_counters[i].load(memory_order_relaxed); }
+	for (size_t i = 0; i < BUCKETS_QTY; ++i)
+	{
+		s.rtt_buckets[i] = m_rtt_buckets[i].load(memory_order_relaxed);
+		s.rtt_qty += s.rtt_buckets[i];
+	}
+	s.rtt_sum_ns = m_rtt_sum_ns.load(memory_order_relaxed);
+	return s;
+}
+
+uint64_t ClientMetrics::Snapshot::RttPercentileNs(double p) const
+{
+	if (0 == rtt_qty) return 0;
+	uint64_t const rank = min<uint64_t>(rtt_qty, static_cast<uint64_t>(p*rtt_qty) + 1);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS_QTY; ++i)
+	{
+		seen += rtt_buckets[i];
+		if (seen >= rank) return BucketUpperBound(i);
+	}
+	return BucketUpperBound(BUCKETS_QTY - 1);
+}
+
+namespace
+{
+	struct Percentile
+	{
+		const char* name;
+		double      p;
+	};
+	constexpr Percentile percentiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}, {"max", 1.0}};
+}
+
+string ClientMetrics::Snapshot::ToText() const
+{
+	string text;
+	for (size_t i = 0; i < COUNTERS_QTY; ++i)
+	{
+		text.append(GetName(static_cast<Counter_e>(i))).append(" ").append(to_string(counters[i])).append("\n");
+	}
+	text.append("rtt_qty ").append(to_string(rtt_qty)).append("\n");
+	text.append("rtt_sum_ns ").append(to_string(rtt_sum_ns)).append("\n");
+	for (auto const& percentile : percentiles)
+	{
+		text.append("rtt_").append(percentile.name).append("_ns ").append(to_string(RttPercentileNs(percentile.p))).append("\n");
+	}
+	return text;
+}
+
+string ClientMetrics::Snapshot::ToJson() const
+{
+	string json{"{"};
+	for (size_t i = 0; i < COUNTERS_QTY; ++i)
+	{
+		json.append("\"").append(GetName(static_cast<Counter_e>(i))).append("\":").append(to_string(counters[i])).append(",");
+	}
+	json.append("\"rtt\":{\"qty\":").append(to_string(rtt_qty));
+	json.append(",\"sum_ns\":").append(to_string(rtt_sum_ns));
+	for (auto const& percentile : percentiles)
+	{
+		json.append(",\"").append(percentile.name).append("_ns\":").append(to_string(RttPercentileNs(percentile.p)));
+	}
+	//only not empty buckets as [upper bound, qty] pairs
+	json.append(",\"buckets\":[");
+	bool is_first = true;
+	for (size_t i = 0; i < BUCKETS_QTY; ++i)
+	{
+		if (0 == rtt_buckets[i]) continue;
+		if (not is_first) json.append(",");
+		is_first = false;
+		json.append("[").append(to_string(BucketUpperBound(i))).append(",").append(to_string(rtt_buckets[i])).append("]");
+	}
+	json.append("]}}");
+	return json;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//Counters and round trip time histogram of one Client.
+//Written only by the thread using the Client, so increments are plain relaxed
+//load/store without locked instructions; any thread can take a snapshot.
+class ClientMetrics
+{
+public:
+	enum class Counter_e : uint8_t
+	{
+		REQUESTS,
+		FAILED_REQUESTS,
+		SYSCALLS,
+		EINTR_RETRIES,
+		PARTIAL_WRITES,
+		DUPLICATED_FRAGMENTS,
+		DAMAGED_FRAGMENTS,
+		FOREIGN_FRAGMENTS,
+		UDP_RETRANSMITS,
+		UDP_RESEND_REQUESTS,
+		TIMEOUTS,
+		BYTES_OUT,
+		BYTES_IN,
+		QTY
+	};
+	static constexpr std::size_t COUNTERS_QTY = static_cast<std::size_t>(Counter_e::QTY);
+	
+	//log-linear buckets: every power of 2 range is split into SUB_BUCKETS_QTY equal parts,
+	//so relative error of a percentile is below 1/SUB_BUCKETS_QTY
+	static constexpr unsigned    SUB_BUCKETS_BITS = 3;
+	static constexpr std::size_t SUB_BUCKETS_QTY = 1 << SUB_BUCKETS_BITS;
+	static constexpr std::size_t BUCKETS_QTY = (64 - SUB_BUCKETS_BITS + 1)*SUB_BUCKETS_QTY;
+	
+	struct Snapshot
+	{
+		std::array<uint64_t, COUNTERS_QTY> counters{};
+		std::array<uint64_t, BUCKETS_QTY>  rtt_buckets{};
+		uint64_t rtt_qty{0};
+		uint64_t rtt_sum_ns{0};
+		
+		uint64_t Get(Counter_e counter) const { return counters[static_cast<std::size_t>(counter)]; }
+		//upper bound of the bucket holding p-th part of RTT samples, p is in [0, 1]
+		uint64_t RttPercentileNs(double p) const;
+		//"name value" lines
+		std::string ToText() const;
+		std::string ToJson() const;
+	};
+	
+	void Add(Counter_e counter, uint64_t value = 1)
+	{
+		auto& c = m_counters[static_cast<std::size_t>(counter)];
+		c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+	void AddRtt(uint64_t ns)
+	{
+		auto& b = m_rtt_buckets[BucketIndex(ns)];
+		b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		m_rtt_sum_ns.store(m_rtt_sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	}
+	uint64_t Get(Counter_e counter) const { return m_counters[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed); }
+	//counters are read one by one, so they may be not consistent with each other by a few events
+	Snapshot GetSnapshot() const;
+	
+	static const char* GetName(Counter_e counter);
+	static std::size_t BucketIndex(uint64_t value);
+	static uint64_t BucketUpperBound(std::size_t index);
+private:
+	std::array<std::atomic<uint64_t>, COUNTERS_QTY> m_counters{};
+	std::array<std::atomic<uint64_t>, BUCKETS_QTY>  m_rtt_buckets{};
+	std::atomic<uint64_t> m_rtt_sum_ns{0};
+};
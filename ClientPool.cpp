@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <sched.h>
+#include "ClientPool.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("ClientPool.cpp: ", args...);
+}
+
+constexpr size_t MIN_RECONNECT_DELAY_MS = 10;
+
+ClientPool::ClientPool(std::vector<std::string> servers, std::size_t connections_per_server, std::size_t shards_qty)
+	: m_shards(shards_qty > 0 ? shards_qty : max(1u, thread::hardware_concurrency()))
+{
+	for (auto& shard : m_shards)
+	{
+		for (auto const& server : servers)
+		{
+			for (size_t i = 0; i < connections_per_server; ++i)
+			{
+				auto& c = shard.connections.emplace_back(make_unique<Connection>());
+				c->params = server;
+			}
+		}
+	}
+	m_reconnector = thread([this]{ Reconnect(); });
+}
+
+ClientPool::~ClientPool()
+{
+	{
+		lock_guard<mutex> lock(m_broken_mutex);
+		m_is_stopped = true;
+	}
+	m_broken_cv.notify_all();
+	m_reconnector.join();
+}
+
+ClientPool::Res_e ClientPool::Start()
+{
+	for (auto& shard : m_shards)
+	{
+		for (auto& c : shard.connections)
+		{
+			lock_guard<mutex> lock(c->mutex);
+			c->client.SetUdpConnected(m_udp_connected);
+			//connects do not wait for each other, background thread completes them
+			c->client.SetReconnect(true);
+			auto const res = c->client.StartInBackground(c->params);
+			if (Res_e::SUCCESS == res or Res_e::ALREADY_STARTED == res) {
+				c->is_ready.store(true, memory_order_release);
+			}
+			else if (Res_e::RECONNECTING == res or Res_e::FAILURE == res or Res_e::TEMPORARY_UNSUFFICIENT_RESOURCES == res) {
+				//parameters are valid, server is not available yet
+				ScheduleReconnect(*c);
+			}
+			else
+			{
+				Log<LogLevel::ERROR>("Invalid server parameters ", c->params);
+				return res;
+			}
+		}
+	}
+	{
+		unique_lock<mutex> lock(m_broken_mutex);
+		m_broken_cv.wait_for(lock, chrono::milliseconds(START_TIMEOUT_MS), [this]{ return GetReadyQty() > 0; });
+	}
+	size_t const ready = GetReadyQty();
+	Log<LogLevel::INFO>(ready, " connections of ", m_shards.size(), " shards are ready");
+	return ready > 0 ? Res_e::SUCCESS : Res_e::FAILURE;
+}
+
+std::size_t ClientPool::GetReadyQty() const
+{
+	size_t ready = 0;
+	for (auto const& shard : m_shards)
+	{
+		for (auto const& c : shard.connections) { ready += c->is_ready.load(memory_order_relaxed); }
+	}
+	return ready;
+}
+
+std::size_t ClientPool::GetShardIndex() const
+{
+	int const cpu = sched_getcpu();
+	if (cpu >= 0) return cpu % m_shards.size();
+	//without cpu number threads are spread round robin
+	static atomic<size_t> next_thread{0};
+	thread_local size_t const thread_index = next_thread.fetch_add(1, memory_order_relaxed);
+	return thread_index % m_shards.size();
+}
+
+ClientPool::Connection* ClientPool::Pick(Shard& shard)
+{
+	Connection* best = nullptr;
+	size_t best_outstanding = SIZE_MAX;
+	for (auto& c : shard.connections)
+	{
+		if (not c->is_ready.load(memory_order_acquire)) continue;
+		size_t const outstanding = c->outstanding.load(memory_order_relaxed);
+		if (outstanding < best_outstanding)
+		{
+			best = c.get();
+			best_outstanding = outstanding;
+			if (0 == outstanding) break;
+		}
+	}
+	return best;
+}
+
+ClientPool::Res_e ClientPool::SendMsg(std::string_view msg, std::string& answer)
+{
+	size_t const first = GetShardIndex();
+	//own shard first, other shards only if all own connections are broken
+	for (size_t i = 0; i < m_shards.size(); ++i)
+	{
+		Shard& shard = m_shards[(first + i) % m_shards.size()];
+		for (size_t attempt = 0; attempt < shard.connections.size(); ++attempt)
+		{
+			Connection* c = Pick(shard);
+			if (not c) break;
+			auto const res = SendMsg(*c, msg, answer);
+			if (Res_e::CONNECTION_BROKEN != res and Res_e::NOT_STARTED != res and Res_e::RECONNECTING != res) return res;
+		}
+	}
+	Log<LogLevel::WARNING>("No ready connection for request");
+	return Res_e::CONNECTION_BROKEN;
+}
+
+ClientPool::Res_e ClientPool::SendMsg(Connection& c, std::string_view msg, std::string& answer)
+{
+	c.outstanding.fetch_add(1, memory_order_relaxed);
+	Res_e res;
+	{
+		lock_guard<mutex> lock(c.mutex);
+		//connection might be broken while this thread waited for it
+		if (not c.is_ready.load(memory_order_relaxed)) {
+			res = Res_e::NOT_STARTED;
+		}
+		else {
+			res = c.client.SendMsg(msg, answer);
+			if (Res_e::CONNECTION_BROKEN == res or Res_e::RECONNECTING == res) { ScheduleReconnect(c); }
+		}
+	}
+	c.outstanding.fetch_sub(1, memory_order_relaxed);
+	return res;
+}
+
+void ClientPool::ScheduleReconnect(Connection& c)
+{
+	c.is_ready.store(false, memory_order_release);
+	c.next_attempt = chrono::steady_clock::now();
+	Log<LogLevel::WARNING>("Connection to ", c.params, " is scheduled for reconnect");
+	{
+		lock_guard<mutex> lock(m_broken_mutex);
+		m_broken.push_back(&c);
+	}
+	m_broken_cv.notify_all();
+}
+
+bool ClientPool::Reconnect(Connection& c)
+{
+	lock_guard<mutex> lock(c.mutex);
+	auto res = c.client.Reconnect();
+	//UDP client and client which failed to start are not reconnecting
+	if (Res_e::NOT_STARTED == res) { res = c.client.StartInBackground(c.params); }
+	if (Res_e::SUCCESS == res or Res_e::ALREADY_STARTED == res)
+	{
+		Log<LogLevel::INFO>("Connection to ", c.params, " is restored");
+		c.is_ready.store(true, memory_order_release);
+		return true;
+	}
+	//connect in progress is checked again after the shortest delay
+	c.next_attempt = max(c.client.GetReconnectTime(), chrono::steady_clock::now() + chrono::milliseconds(MIN_RECONNECT_DELAY_MS));
+	return false;
+}
+
+void ClientPool::Reconnect()
+{
+	vector<Connection*> due;
+	unique_lock<mutex> lock(m_broken_mutex);
+	while (not m_is_stopped)
+	{
+		//every connection has own reconnect time, the thread sleeps till the nearest one or new broken connection
+		auto const now = chrono::steady_clock::now();
+		auto next = chrono::steady_clock::time_point::max();
+		for (size_t i = 0; i < m_broken.size();)
+		{
+			Connection* c = m_broken[i];
+			if (c->next_attempt <= now)
+			{
+				due.push_back(c);
+				m_broken[i] = m_broken.back();
+				m_broken.pop_back();
+				continue;
+			}
+			next = min(next, c->next_attempt);
+			++i;
+		}
+		if (due.empty())
+		{
+			if (next == chrono::steady_clock::time_point::max()) m_broken_cv.wait(lock);
+			else m_broken_cv.wait_until(lock, next);
+			continue;
+		}
+		lock.unlock();
+		
+		bool is_restored = false;
+		for (size_t i = 0; i < due.size();)
+		{
+			if (Reconnect(*due[i]))
+			{
+				is_restored = true;
+				due[i] = due.back();
+				due.pop_back();
+				continue;
+			}
+			++i;
+		}
+		
+		lock.lock();
+		m_broken.insert(m_broken.end(), due.begin(), due.end());
+		due.clear();
+		if (is_restored) { m_broken_cv.notify_all(); }
+	}
+}
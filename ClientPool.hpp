@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Client.hpp"
+
+//Keeps warm connections to one or more servers for many threads.
+//Connections are split into shards, thread uses the shard of the core it runs on
+//and the connection with the least outstanding requests in it.
+//Broken connections are restarted by background thread, requests go to other ones meanwhile.
+class ClientPool
+{
+	//connects are started at once, Start waits for the first of them no longer than this
+	static constexpr std::size_t START_TIMEOUT_MS = 3000;
+public:
+	using Res_e = Client::Res_e;
+	
+	//servers are "PROTO,IPv4,PORT" like for Client::Start, shards_qty 0 means number of cores
+	ClientPool(std::vector<std::string> servers, std::size_t connections_per_server, std::size_t shards_qty = 0);
+	~ClientPool();
+	//starts connects of all connections at once, SUCCESS if at least one of them is connected in START_TIMEOUT_MS,
+	//the rest are completed by background thread
+	Res_e Start();
+	//request through the least loaded ready connection, answer is written right into answer
+	Res_e SendMsg(std::string_view msg, std::string& answer);
+	//UDP connections use connected sockets, every one has own source port, so answers to different shards
+	//are spread over receive queues of network card.Applied by Start()
+	void SetUdpConnected(bool enable) { m_udp_connected = enable; }
+	std::size_t GetShardsQty() const { return m_shards.size(); }
+	std::size_t GetReadyQty() const;
+private:
+	struct Connection
+	{
+		std::string         params;
+		Client              client;
+		std::mutex          mutex;
+		std::atomic<size_t> outstanding{0};
+		std::atomic<bool>   is_ready{false};
+		//Client keeps backoff of reconnect, its next step is not taken before this time
+		std::chrono::steady_clock::time_point next_attempt;
+	};
+	struct alignas(64) Shard
+	{
+		std::vector<std::unique_ptr<Connection>> connections;
+	};
+	std::size_t GetShardIndex() const;
+	Connection* Pick(Shard& shard);
+	Res_e SendMsg(Connection& c, std::string_view msg, std::string& answer);
+	void ScheduleReconnect(Connection& c);
+	//takes the next reconnect step of connection, true once it is ready
+	bool Reconnect(Connection& c);
+	void Reconnect();
+	
+	std::vector<Shard>       m_shards;
+	std::mutex               m_broken_mutex;
+	//signals new broken connection to background thread and restored one to Start
+	std::condition_variable  m_broken_cv;
+	std::vector<Connection*> m_broken;
+	bool                     m_is_stopped{false};
+	bool                     m_udp_connected{false};
+	std::thread              m_reconnector;
+};
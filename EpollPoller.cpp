@@ -0,0 +1,82 @@
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "EpollPoller.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("EpollPoller.cpp: ", args...);
+}
+
+constexpr int MAX_EPOLL_EVENTS = 256;
+
+EpollPoller::~EpollPoller()
+{
+	if (-1 != m_desc) { close(m_desc); }
+}
+
+bool EpollPoller::Init()
+{
+	m_desc = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == m_desc)
+	{
+		Log<LogLevel::ERROR>("Creation of epoll instance failed: ", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool EpollPoller::Add(int fd, uint32_t events, void* ctx)
+{
+	//poll and epoll bits have the same values
+	epoll_event ev{};
+	ev.events = events;
+	ev.data.ptr = ctx;
+	if (-1 == epoll_ctl(m_desc, EPOLL_CTL_ADD, fd, &ev))
+	{
+		Log<LogLevel::ERROR>("Add of socket ", fd, " to epoll failed: ", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool EpollPoller::Modify(int fd, uint32_t events, void* ctx)
+{
+	epoll_event ev{};
+	ev.events = events;
+	ev.data.ptr = ctx;
+	if (-1 == epoll_ctl(m_desc, EPOLL_CTL_MOD, fd, &ev))
+	{
+		Log<LogLevel::ERROR>("Modification of socket ", fd, " in epoll failed: ", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void EpollPoller::Remove(int fd)
+{
+	epoll_ctl(m_desc, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int EpollPoller::Wait(Event* events, int max_events, int timeout_ms)
+{
+	epoll_event ep_events[MAX_EPOLL_EVENTS];
+	int const res = epoll_wait(m_desc, ep_events, min(max_events, MAX_EPOLL_EVENTS), timeout_ms);
+	if (-1 == res)
+	{
+		if (errno == EINTR) return 0;
+		Log<LogLevel::ERROR>("Wait for epoll events failed: ", strerror(errno));
+		return -1;
+	}
+	for (int i = 0; i < res; ++i)
+	{
+		events[i].ctx = ep_events[i].data.ptr;
+		events[i].events = ep_events[i].events;
+	}
+	return res;
+}
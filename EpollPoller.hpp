@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Poller.hpp"
+
+class EpollPoller : public Poller
+{
+public:
+	~EpollPoller() override;
+	bool Init();
+	bool Add(int fd, uint32_t events, void* ctx) override;
+	bool Modify(int fd, uint32_t events, void* ctx) override;
+	void Remove(int fd) override;
+	int Wait(Event* events, int max_events, int timeout_ms) override;
+private:
+	int m_desc{-1};
+};
@@ -0,0 +1,534 @@
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "EventLoop.hpp"
+#include "RecvBuffer.hpp"
+#include "RtoEstimator.hpp"
+#include "UdpFragmenter.hpp"
+#include "UdpPacket.hpp"
+#include "UdpReassembler.hpp"
+#include "UdpRequestTimer.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("EventLoop.cpp: ", args...);
+}
+
+struct EventLoop::Session
+{
+	struct UdpRequest
+	{
+		uint32_t    id;
+		std::string msg;
+		std::string answer;
+		Callback    callback;
+		UdpRequestTimer timer;
+	};
+	
+	SessionId   id;
+	int         proto;
+	int         desc{-1};
+	sockaddr_in server_sa;
+	bool        is_connected{false};
+	bool        is_closed{false};
+	bool        is_to_write{false};
+	uint32_t    interest{0};
+	
+	//TCP: requests are written from out, answers are matched to pending in FIFO order
+	std::string          out;
+	std::size_t          out_pos{0};
+	RecvBuffer           in;
+	std::deque<Callback> pending;
+	std::string          answer;
+	
+	//UDP: requests before udp_next_to_send are completely sent
+	std::deque<std::unique_ptr<UdpRequest>> udp_requests;
+	std::size_t    udp_next_to_send{0};
+	bool           is_fragmenter_built{false};
+	UdpFragmenter  fragmenter;
+	UdpReassembler reassembler;
+	uint32_t       udp_msg_id{0};
+	uint16_t       udp_packet_size{0};
+	bool           udp_has_msg_id{false};
+	RtoEstimator   udp_rto;
+	
+	std::size_t InFlight() const { return IPPROTO_TCP == proto ? pending.size() : udp_requests.size(); }
+};
+
+EventLoop::EventLoop(Poller::Type_e type) : m_poller(Poller::Create(type))
+{
+	if (not m_poller) {
+		Log<LogLevel::ERROR>("Poller ", Poller::Type_e::EPOLL == type ? "epoll" : "io_uring", " is not available");
+	}
+}
+
+EventLoop::~EventLoop()
+{
+	for (auto& s : m_sessions)
+	{
+		if (s and not s->is_closed) { CloseSession(*s, Res_e::FAILURE); }
+	}
+}
+
+EventLoop::Res_e EventLoop::AddSession(std::string_view params, SessionId& id)
+{
+	if (not m_poller) return Res_e::FAILURE;
+	
+	auto s = make_unique<Session>();
+	if (auto const res = Client::ParseParams(params, s->proto, s->server_sa); Res_e::SUCCESS != res) { return res; }
+	
+	s->desc = socket(AF_INET, ((s->proto == IPPROTO_TCP) ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, s->proto);
+	if (-1 == s->desc)
+	{
+		Log<LogLevel::ERROR>("Creation of socket failed: ", strerror(errno));
+		if ((errno == ENFILE)or(errno == EMFILE)or(errno == ENOBUFS)or(errno == ENOMEM)) {
+			return Res_e::TEMPORARY_UNSUFFICIENT_RESOURCES;
+		}
+		return Res_e::FAILURE;
+	}
+	
+	if (IPPROTO_TCP == s->proto)
+	{
+		if (-1 == connect(s->desc, (sockaddr const*)&s->server_sa, sizeof(s->server_sa)))
+		{
+			if (errno != EINPROGRESS)
+			{
+				Log<LogLevel::ERROR>("Connect to TCP server failed: ", strerror(errno));
+				close(s->desc);
+				return Res_e::FAILURE;
+			}
+			//completion of connect is reported by POLLOUT
+			s->interest = POLLOUT;
+		}
+		else
+		{
+			s->is_connected = true;
+			s->interest = POLLIN;
+		}
+	}
+	else
+	{
+		int const pmtu_mode = IP_PMTUDISC_DO;
+		setsockopt(s->desc, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu_mode, sizeof(pmtu_mode));
+		s->udp_packet_size = UdpFragmenter::DiscoverPacketSize(s->server_sa, m_udp_cfg_packet_size);
+		s->udp_has_msg_id = m_udp_has_msg_id;
+		s->fragmenter.SetMessageId(m_udp_has_msg_id);
+		s->reassembler.SetMessageId(m_udp_has_msg_id);
+		s->is_connected = true;
+		s->interest = POLLIN;
+	}
+	
+	if (m_free_ids.empty())
+	{
+		s->id = m_sessions.size();
+		m_sessions.emplace_back();
+	}
+	else
+	{
+		s->id = m_free_ids.back();
+		m_free_ids.pop_back();
+	}
+	if (not m_poller->Add(s->desc, s->interest, s.get()))
+	{
+		close(s->desc);
+		m_free_ids.push_back(s->id);
+		return Res_e::FAILURE;
+	}
+	id = s->id;
+	Log("Session ", id, " uses socket ", s->desc);
+	if (IPPROTO_UDP == s->proto) { m_udp_sessions.push_back(id); }
+	m_sessions[id] = move(s);
+	return Res_e::SUCCESS;
+}
+
+void EventLoop::RemoveSession(SessionId id)
+{
+	if (id >= m_sessions.size() or not m_sessions[id]) return;
+	Session& s = *m_sessions[id];
+	if (not s.is_closed) { CloseSession(s, Res_e::CONNECTION_BROKEN); }
+	if (IPPROTO_UDP == s.proto)
+	{
+		auto const it = find(m_udp_sessions.begin(), m_udp_sessions.end(), id);
+		if (it != m_udp_sessions.end())
+		{
+			*it = m_udp_sessions.back();
+			m_udp_sessions.pop_back();
+		}
+	}
+	m_removed.push_back(move(m_sessions[id]));
+	m_free_ids.push_back(id);
+}
+
+std::size_t EventLoop::GetInFlight(SessionId id) const
+{
+	if (id >= m_sessions.size() or not m_sessions[id]) return 0;
+	return m_sessions[id]->InFlight();
+}
+
+EventLoop::Res_e EventLoop::Submit(SessionId id, std::string_view msg, Callback callback)
+{
+	if (id >= m_sessions.size() or not m_sessions[id]) return Res_e::NOT_STARTED;
+	Session& s = *m_sessions[id];
+	if (s.is_closed) return Res_e::CONNECTION_BROKEN;
+	if (msg.empty()) return Res_e::NO_DATA_TO_SEND;
+	//without MESSAGE_ID answers of UDP requests can not be told apart
+	size_t const window = (IPPROTO_UDP == s.proto and not s.udp_has_msg_id) ? 1 : m_window;
+	if (s.InFlight() >= window) return Res_e::WINDOW_IS_FULL;
+	
+	if (IPPROTO_TCP == s.proto)
+	{
+		s.out.append(msg);
+		s.out.push_back('\n');
+		s.pending.push_back(move(callback));
+	}
+	else
+	{
+		auto request = make_unique<Session::UdpRequest>();
+		request->id = ++s.udp_msg_id;
+		request->msg = msg;
+		request->callback = move(callback);
+		request->timer.Start(m_udp_timeout.count() > 0 ? chrono::steady_clock::now() + m_udp_timeout : chrono::steady_clock::time_point::max(), s.udp_has_msg_id);
+		s.reassembler.Expect(request->id, request->answer);
+		s.udp_requests.push_back(move(request));
+	}
+	QueueWrite(s);
+	return Res_e::SUCCESS;
+}
+
+void EventLoop::QueueWrite(Session& s)
+{
+	if (not s.is_to_write)
+	{
+		s.is_to_write = true;
+		m_to_write.push_back(&s);
+	}
+}
+
+int EventLoop::RunOnce(int timeout_ms)
+{
+	if (not m_poller) return -1;
+	
+	auto write_queued = [this]
+	{
+		//requests submitted from callbacks are added to m_to_write while it is processed
+		for (size_t i = 0; i < m_to_write.size(); ++i)
+		{
+			Session& s = *m_to_write[i];
+			s.is_to_write = false;
+			if (s.is_closed or not s.is_connected) continue;
+			if (IPPROTO_TCP == s.proto) WriteTcp(s);
+			else WriteUdp(s);
+			if (not s.is_closed) UpdateInterest(s);
+		}
+		m_to_write.clear();
+	};
+	
+	HandleUdpTimers();
+	write_queued();
+	int wait_ms = m_to_write.empty() ? timeout_ms : 0;
+	if (m_udp_next_timer != chrono::steady_clock::time_point::max())
+	{
+		auto const till_timer = chrono::ceil<chrono::milliseconds>(m_udp_next_timer - chrono::steady_clock::now()).count();
+		int const timer_ms = static_cast<int>(max<decltype(till_timer)>(0, till_timer));
+		wait_ms = (wait_ms < 0) ? timer_ms : min(wait_ms, timer_ms);
+	}
+	Poller::Event events[MAX_EVENTS];
+	int const res = m_poller->Wait(events, MAX_EVENTS, wait_ms);
+	for (int i = 0; i < res; ++i)
+	{
+		Session& s = *static_cast<Session*>(events[i].ctx);
+		if (not s.is_closed) { HandleEvents(s, events[i].events); }
+	}
+	write_queued();
+	m_removed.clear();
+	return res;
+}
+
+void EventLoop::HandleEvents(Session& s, uint32_t events)
+{
+	if (not s.is_connected)
+	{
+		int err = 0;
+		socklen_t len = sizeof(err);
+		if (-1 == getsockopt(s.desc, SOL_SOCKET, SO_ERROR, &err, &len) or err != 0)
+		{
+			Log<LogLevel::ERROR>("Connect of session ", s.id, " to TCP server failed: ", strerror(err ? err : errno));
+			CloseSession(s, Res_e::FAILURE);
+			return;
+		}
+		Log("Session ", s.id, " connected to TCP server");
+		s.is_connected = true;
+	}
+	
+	if (events & (POLLIN | POLLERR | POLLHUP))
+	{
+		if (IPPROTO_TCP == s.proto) ReadTcp(s);
+		else ReadUdp(s);
+		if (s.is_closed) return;
+	}
+	if (IPPROTO_TCP == s.proto) WriteTcp(s);
+	else WriteUdp(s);
+	if (not s.is_closed) UpdateInterest(s);
+}
+
+void EventLoop::ReadTcp(Session& s)
+{
+	while (1)
+	{
+		char* space = s.in.Space();
+		ssize_t const read_bytes = recv(s.desc, space, s.in.SpaceSize(), MSG_DONTWAIT);
+		if (-1 == read_bytes)
+		{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN or errno == EWOULDBLOCK) return;
+			Log<LogLevel::ERROR>("Read of session ", s.id, " failed: ", strerror(errno));
+			CloseSession(s, (errno == ECONNRESET) ? Res_e::CONNECTION_BROKEN : Res_e::FAILURE);
+			return;
+		}
+		if (0 == read_bytes)
+		{
+			Log<LogLevel::WARNING>("Session ", s.id, " is closed by server");
+			CloseSession(s, Res_e::CONNECTION_BROKEN);
+			return;
+		}
+		Log<LogLevel::TRACE>("Session ", s.id, " read ", read_bytes, " bytes");
+		s.in.Commit(read_bytes);
+		
+		while (not s.in.Empty())
+		{
+			char const* data = s.in.Data();
+			char const* end = static_cast<char const*>(memchr(data, '\n', s.in.Size()));
+			size_t const size = end ? end - data : s.in.Size();
+			//the rest of stream can not be trusted after too long answer
+			if (s.answer.size() + size > m_tcp_max_answer_size)
+			{
+				Log<LogLevel::ERROR>("Answer of session ", s.id, " is longer than ", m_tcp_max_answer_size, " bytes");
+				CloseSession(s, Res_e::FAILURE);
+				return;
+			}
+			s.answer.append(data, size);
+			if (not end)
+			{
+				s.in.Consume(size);
+				break;
+			}
+			s.in.Consume(size + 1);
+			if (s.pending.empty())
+			{
+				Log<LogLevel::WARNING>("Session ", s.id, " received answer without request");
+				s.answer.clear();
+				continue;
+			}
+			Client::ConvertTcpAnswer(s.answer);
+			auto callback = move(s.pending.front());
+			s.pending.pop_front();
+			if (callback) { callback(Res_e::SUCCESS, s.answer); }
+			s.answer.clear();
+			if (s.is_closed) return;
+		}
+	}
+}
+
+void EventLoop::ReadUdp(Session& s)
+{
+	while (1)
+	{
+		int const read_packets = m_udp_recv.Recv(s.desc);
+		if (-1 == read_packets)
+		{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN or errno == EWOULDBLOCK) return;
+			//ICMP errors of previous datagrams are reported here, they do not break the session
+			Log<LogLevel::WARNING>("Read of session ", s.id, " failed: ", strerror(errno));
+			return;
+		}
+		auto const now = chrono::steady_clock::now();
+		for (int k = 0; k < read_packets; ++k)
+		{
+			if (m_udp_recv.IsTruncated(k)) continue;
+			uint32_t msg_id;
+			auto const added = s.reassembler.Add(m_udp_recv.GetData(k), m_udp_recv.GetSize(k), msg_id);
+			if (UdpReassembler::Res_e::MESSAGE_COMPLETED != added and UdpReassembler::Res_e::FRAGMENT_ADDED != added) continue;
+			auto it = find_if(s.udp_requests.begin(), s.udp_requests.end(), [msg_id](auto const& r){ return r->id == msg_id; });
+			if (it == s.udp_requests.end()) continue;
+			(*it)->timer.OnProgress(now, s.udp_rto);
+			if (UdpReassembler::Res_e::FRAGMENT_ADDED == added) continue;
+			
+			size_t const index = it - s.udp_requests.begin();
+			//answer may come before all fragments are sent only from broken server, the rest is not sent then
+			if (index < s.udp_next_to_send) { --s.udp_next_to_send; }
+			else if (index == s.udp_next_to_send) { s.is_fragmenter_built = false; }
+			auto request = move(*it);
+			s.udp_requests.erase(it);
+			if (request->callback) { request->callback(Res_e::SUCCESS, request->answer); }
+			if (s.is_closed) return;
+		}
+		if (static_cast<size_t>(read_packets) < UDP_MMSG_BATCH_SIZE) return;
+	}
+}
+
+void EventLoop::DropUdpInput(Session& s)
+{
+	if (auto const dropped = m_udp_recv.Drop(s.desc); dropped > 0) { Log("Session ", s.id, " drops ", dropped, " late packets"); }
+}
+
+void EventLoop::WriteTcp(Session& s)
+{
+	while (s.out_pos != s.out.size())
+	{
+		ssize_t const written_bytes = send(s.desc, s.out.data() + s.out_pos, s.out.size() - s.out_pos, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (-1 == written_bytes)
+		{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN or errno == EWOULDBLOCK) return;
+			Log<LogLevel::ERROR>("Write of session ", s.id, " failed: ", strerror(errno));
+			CloseSession(s, (errno == ECONNRESET or errno == EPIPE) ? Res_e::CONNECTION_BROKEN : Res_e::FAILURE);
+			return;
+		}
+		Log<LogLevel::TRACE>("Session ", s.id, " write ", written_bytes, " bytes");
+		s.out_pos += written_bytes;
+	}
+	s.out.clear();
+	s.out_pos = 0;
+}
+
+void EventLoop::WriteUdp(Session& s)
+{
+	while (s.udp_next_to_send < s.udp_requests.size())
+	{
+		auto& request = *s.udp_requests[s.udp_next_to_send];
+		if (not s.is_fragmenter_built)
+		{
+			//without MESSAGE_ID late fragments of previous timed out request would be taken for answer of this one
+			if (not s.udp_has_msg_id) { DropUdpInput(s); }
+			s.fragmenter.Build(request.msg, s.udp_packet_size, request.id, false, &s.server_sa);
+			s.is_fragmenter_built = true;
+		}
+		while (not s.fragmenter.IsSent())
+		{
+			if (-1 != s.fragmenter.Send(s.desc, MSG_DONTWAIT)) continue;
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN or errno == EWOULDBLOCK) return;
+			
+			Log<LogLevel::ERROR>("Write of session ", s.id, " failed: ", strerror(errno));
+			s.is_fragmenter_built = false;
+			s.reassembler.Forget(request.id);
+			auto failed = move(s.udp_requests[s.udp_next_to_send]);
+			s.udp_requests.erase(s.udp_requests.begin() + s.udp_next_to_send);
+			if (failed->callback) { failed->callback(Res_e::FAILURE, {}); }
+			if (s.is_closed) return;
+			break;
+		}
+		if (s.is_fragmenter_built)
+		{
+			s.is_fragmenter_built = false;
+			++s.udp_next_to_send;
+			request.timer.OnSent(chrono::steady_clock::now(), s.udp_rto);
+			m_udp_next_timer = min(m_udp_next_timer, request.timer.GetNext());
+		}
+	}
+}
+
+void EventLoop::UpdateInterest(Session& s)
+{
+	bool const has_output = (IPPROTO_TCP == s.proto) ? (s.out_pos != s.out.size()) : (s.udp_next_to_send < s.udp_requests.size());
+	uint32_t const interest = (not s.is_connected) ? POLLOUT : (POLLIN | (has_output ? POLLOUT : 0));
+	if (interest != s.interest)
+	{
+		s.interest = interest;
+		m_poller->Modify(s.desc, interest, &s);
+	}
+}
+
+void EventLoop::CloseSession(Session& s, Res_e res)
+{
+	Log("Session ", s.id, " socket ", s.desc, " will be closed");
+	m_poller->Remove(s.desc);
+	close(s.desc);
+	s.desc = -1;
+	s.is_closed = true;
+	
+	auto pending = move(s.pending);
+	s.pending.clear();
+	auto udp_requests = move(s.udp_requests);
+	s.udp_requests.clear();
+	for (auto& callback : pending)
+	{
+		if (callback) { callback(res, {}); }
+	}
+	for (auto& request : udp_requests)
+	{
+		s.reassembler.Forget(request->id);
+		if (request->callback) { request->callback(res, {}); }
+	}
+}
+
+void EventLoop::HandleUdpTimers()
+{
+	auto const now = chrono::steady_clock::now();
+	auto next = chrono::steady_clock::time_point::max();
+	//callbacks may add and remove sessions, so sessions are taken by id every time
+	for (size_t i = 0; i < m_udp_sessions.size(); ++i)
+	{
+		SessionId const id = m_udp_sessions[i];
+		if (id >= m_sessions.size() or not m_sessions[id]) continue;
+		Session& s = *m_sessions[id];
+		for (size_t k = 0; k < s.udp_requests.size() and not s.is_closed;)
+		{
+			auto& request = *s.udp_requests[k];
+			//requests not sent completely yet have no retransmission timer
+			auto const action = request.timer.OnTimer(now, s.udp_rto, s.reassembler, request.id, m_udp_missing, UdpResendMaxQty(s.udp_packet_size));
+			if (UdpRequestTimer::Action_e::TIMEOUT == action)
+			{
+				Log<LogLevel::WARNING>("Session ", s.id, " did not receive answer of message ", request.id, " in time");
+				if (k < s.udp_next_to_send) { --s.udp_next_to_send; }
+				else if (k == s.udp_next_to_send) { s.is_fragmenter_built = false; }
+				s.reassembler.Forget(request.id);
+				auto expired = move(s.udp_requests[k]);
+				s.udp_requests.erase(s.udp_requests.begin() + k);
+				if (expired->callback) { expired->callback(Res_e::TIMEOUT, {}); }
+				continue;
+			}
+			if (UdpRequestTimer::Action_e::SEND_AGAIN == action)
+			{
+				Log("Session ", s.id, " sends again message ", request.id);
+				//request goes to the end of send queue
+				auto repeated = move(s.udp_requests[k]);
+				s.udp_requests.erase(s.udp_requests.begin() + k);
+				--s.udp_next_to_send;
+				s.udp_requests.push_back(move(repeated));
+				QueueWrite(s);
+				continue;
+			}
+			if (UdpRequestTimer::Action_e::ASK_RESEND == action)
+			{
+				Log("Session ", s.id, " asks to resend fragments of message ", request.id);
+				AskUdpResend(s, request.id);
+			}
+			next = min(next, request.timer.GetNext());
+			++k;
+		}
+	}
+	m_udp_next_timer = next;
+}
+
+void EventLoop::AskUdpResend(Session& s, uint32_t msg_id)
+{
+	UdpFragmenter::BuildResend(m_udp_resend_packet, msg_id, m_udp_missing, s.udp_packet_size);
+	while (-1 == sendto(s.desc, m_udp_resend_packet.data(), m_udp_resend_packet.size(), MSG_DONTWAIT, (sockaddr const*)&s.server_sa, sizeof(s.server_sa)))
+	{
+		if (errno == EINTR) continue;
+		//lost resend request is repeated by the next timeout
+		Log<LogLevel::WARNING>("Resend request of session ", s.id, " failed: ", strerror(errno));
+		return;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Client.hpp"
+#include "Poller.hpp"
+#include "TcpPacket.hpp"
+#include "UdpRecvBatch.hpp"
+
+//Drives many non-blocking client sessions from one thread.
+//Sessions speak the same TCP/UDP framing as Client, requests are pipelined:
+//TCP answers come in the order of requests, UDP ones are matched by MESSAGE_ID if it is enabled,
+//otherwise UDP session has one request in flight.
+//Submit only queues request, data is written by RunOnce, callbacks are called from RunOnce.
+//UDP requests with MESSAGE_ID are repeated by RunOnce with adaptive timeout until answer is completed or deadline passes.
+class EventLoop
+{
+	static constexpr int MAX_EVENTS = 256;
+public:
+	using Res_e = Client::Res_e;
+	using Callback = Client::Callback;
+	using SessionId = std::size_t;
+	
+	explicit EventLoop(Poller::Type_e type = Poller::Type_e::EPOLL);
+	~EventLoop();
+	//false if poller backend is not available
+	bool IsValid() const { return static_cast<bool>(m_poller); }
+	
+	//starts non-blocking connect, requests may be submitted right away
+	Res_e AddSession(std::string_view params, SessionId& id);
+	void RemoveSession(SessionId id);
+	//WINDOW_IS_FULL if session already has SetWindow() requests without answer(one for UDP without MESSAGE_ID)
+	Res_e Submit(SessionId id, std::string_view msg, Callback callback);
+	//writes queued requests, waits for events up to timeout_ms(-1 is infinite) and handles them,
+	//returns number of handled events or -1 on poller failure
+	int RunOnce(int timeout_ms);
+	
+	std::size_t GetInFlight(SessionId id) const;
+	void SetWindow(std::size_t window) { m_window = window > 0 ? window : 1; }
+	//UDP packet size for sessions added later like Client::SetUdpPacketSize, 0 means path MTU
+	void SetUdpPacketSize(uint16_t size) { m_udp_cfg_packet_size = size; }
+	//UDP sessions added later use MESSAGE_ID header like Client::SetUdpMessageId
+	void SetUdpMessageId(bool enable) { m_udp_has_msg_id = enable; }
+	//UDP request submitted later fails with TIMEOUT if its answer is not completed in this time, 0 means no limit
+	void SetUdpTimeout(std::chrono::milliseconds timeout) { m_udp_timeout = timeout; }
+	//TCP answer longer than this closes its session with FAILURE like Client::SetTcpMaxAnswerSize
+	void SetTcpMaxAnswerSize(std::size_t size) { m_tcp_max_answer_size = size; }
+private:
+	struct Session;
+	void HandleEvents(Session& s, uint32_t events);
+	void ReadTcp(Session& s);
+	void ReadUdp(Session& s);
+	void WriteTcp(Session& s);
+	void WriteUdp(Session& s);
+	void UpdateInterest(Session& s);
+	void QueueWrite(Session& s);
+	//fails expired UDP requests and repeats silent ones, sets m_udp_next_timer
+	void HandleUdpTimers();
+	void AskUdpResend(Session& s, uint32_t msg_id);
+	//discards datagrams received so far
+	void DropUdpInput(Session& s);
+	void CloseSession(Session& s, Res_e res);
+	
+	std::unique_ptr<Poller>               m_poller;
+	std::vector<std::unique_ptr<Session>> m_sessions;
+	std::vector<SessionId>                m_free_ids;
+	//sessions with queued requests, they are written before waiting for events
+	std::vector<Session*>                 m_to_write;
+	//removed sessions may still have events in current RunOnce
+	std::vector<std::unique_ptr<Session>> m_removed;
+	//UDP sessions have timers to check
+	std::vector<SessionId>                m_udp_sessions;
+	//nearest retransmission or deadline, requests written later lower it
+	std::chrono::steady_clock::time_point m_udp_next_timer{std::chrono::steady_clock::time_point::max()};
+	UdpRecvBatch                          m_udp_recv;
+	std::vector<uint16_t>                 m_udp_missing;
+	std::vector<char>                     m_udp_resend_packet;
+	std::size_t                           m_window{64};
+	uint16_t                              m_udp_cfg_packet_size{UDP_LEGACY_PACKET_SIZE};
+	bool                                  m_udp_has_msg_id{false};
+	std::chrono::milliseconds             m_udp_timeout{5000};
+	std::size_t                           m_tcp_max_answer_size{TCP_DEFAULT_MAX_ANSWER_SIZE};
+};
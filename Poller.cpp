@@ -0,0 +1,18 @@
+#include "Poller.hpp"
+#include "EpollPoller.hpp"
+#include "UringPoller.hpp"
+
+std::unique_ptr<Poller> Poller::Create(Type_e type)
+{
+	if (Type_e::EPOLL == type)
+	{
+		auto poller = std::make_unique<EpollPoller>();
+		if (poller->Init()) return poller;
+	}
+	else
+	{
+		auto poller = std::make_unique<UringPoller>();
+		if (poller->Init()) return poller;
+	}
+	return nullptr;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+//Readiness notification backend of EventLoop.
+//Events are poll bits(POLLIN, POLLOUT, POLLERR, POLLHUP), notification is level triggered.
+class Poller
+{
+public:
+	enum class Type_e : uint8_t
+	{
+		EPOLL,
+		IO_URING
+	};
+	struct Event
+	{
+		void*    ctx;
+		uint32_t events;
+	};
+	//nullptr if backend is not available in this kernel
+	static std::unique_ptr<Poller> Create(Type_e type);
+	
+	virtual ~Poller() = default;
+	virtual bool Add(int fd, uint32_t events, void* ctx) = 0;
+	virtual bool Modify(int fd, uint32_t events, void* ctx) = 0;
+	virtual void Remove(int fd) = 0;
+	//returns number of events, 0 on timeout and -1 on failure, timeout -1 is infinite
+	virtual int Wait(Event* events, int max_events, int timeout_ms) = 0;
+};
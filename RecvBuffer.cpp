@@ -0,0 +1,21 @@
+#include <cstring>
+#include "RecvBuffer.hpp"
+
+char* RecvBuffer::Space()
+{
+	//allocated on the first read, UDP clients never pay for it
+	if (m_buffer.empty()) { m_buffer.resize(m_capacity); }
+	if (SpaceSize() < m_capacity/2 and m_begin > 0)
+	{
+		memmove(m_buffer.data(), m_buffer.data() + m_begin, Size());
+		m_end -= m_begin;
+		m_begin = 0;
+	}
+	return m_buffer.data() + m_end;
+}
+
+void RecvBuffer::Consume(std::size_t size)
+{
+	m_begin += size;
+	if (m_begin == m_end) { m_begin = m_end = 0; }
+}
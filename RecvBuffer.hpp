@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//Per-connection receive buffer.Socket data is read into free space at the end
+//and consumed from the beginning, unconsumed bytes are kept for the next answer.
+class RecvBuffer
+{
+	static constexpr std::size_t DEFAULT_CAPACITY = 64*1024;
+public:
+	explicit RecvBuffer(std::size_t capacity = DEFAULT_CAPACITY) : m_capacity(capacity) {}
+	char const* Data() const { return m_buffer.data() + m_begin; }
+	std::size_t Size() const { return m_end - m_begin; }
+	bool Empty() const { return m_begin == m_end; }
+	//free space for the next read, at least half of capacity if possible
+	char* Space();
+	std::size_t SpaceSize() const { return m_buffer.size() - m_end; }
+	void Commit(std::size_t size) { m_end += size; }
+	void Consume(std::size_t size);
+	void Clear() { m_begin = m_end = 0; }
+private:
+	std::size_t       m_capacity;
+	std::vector<char> m_buffer;
+	std::size_t       m_begin{0};
+	std::size_t       m_end{0};
+};
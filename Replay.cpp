@@ -0,0 +1,231 @@
+#include <cstring>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Replay.hpp"
+#include "EventLoop.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+using Res_e = Client::Res_e;
+using Counter_e = ClientMetrics::Counter_e;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("Replay.cpp: ", args...);
+}
+
+constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+Replay::~Replay()
+{
+	if (m_data) { munmap(const_cast<char*>(m_data), m_size); }
+	if (m_out and m_out != stdout) { fclose(m_out); }
+	else if (m_out) { fflush(m_out); }
+}
+
+bool Replay::Open(char const* requests_path, char const* answers_path)
+{
+	int const desc = open(requests_path, O_RDONLY | O_CLOEXEC);
+	if (-1 == desc)
+	{
+		Log<LogLevel::ERROR>("Open of ", requests_path, " failed: ", strerror(errno));
+		return false;
+	}
+	struct stat st;
+	if (-1 == fstat(desc, &st))
+	{
+		Log<LogLevel::ERROR>("Stat of ", requests_path, " failed: ", strerror(errno));
+		close(desc);
+		return false;
+	}
+	m_size = st.st_size;
+	if (m_size > 0)
+	{
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, desc, 0);
+		if (MAP_FAILED == data)
+		{
+			Log<LogLevel::ERROR>("Mapping of ", requests_path, " failed: ", strerror(errno));
+			close(desc);
+			return false;
+		}
+		//file is read once from beginning to end
+		madvise(data, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<char const*>(data);
+	}
+	close(desc);
+	
+	m_out = answers_path ? fopen(answers_path, "w") : stdout;
+	if (not m_out)
+	{
+		Log<LogLevel::ERROR>("Open of ", answers_path, " failed: ", strerror(errno));
+		return false;
+	}
+	setvbuf(m_out, nullptr, _IOFBF, OUTPUT_BUFFER_SIZE);
+	return true;
+}
+
+bool Replay::NextRequest(std::string_view& request)
+{
+	while (m_pos < m_size)
+	{
+		char const* begin = m_data + m_pos;
+		char const* end = static_cast<char const*>(memchr(begin, '\n', m_size - m_pos));
+		size_t const len = end ? end - begin : m_size - m_pos;
+		m_pos += len + 1;
+		if (len > 0)
+		{
+			request = {begin, len};
+			return true;
+		}
+	}
+	return false;
+}
+
+void Replay::Record(Res_e res, std::chrono::steady_clock::time_point submitted)
+{
+	m_metrics.Add(Counter_e::REQUESTS);
+	if (Res_e::SUCCESS != res)
+	{
+		m_metrics.Add(Counter_e::FAILED_REQUESTS);
+		return;
+	}
+	m_metrics.AddRtt(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - submitted).count());
+}
+
+void Replay::Write(Res_e res, std::string_view answer)
+{
+	if (Res_e::SUCCESS == res) { fwrite(answer.data(), 1, answer.size(), m_out); }
+	fputc('\n', m_out);
+}
+
+Client::Res_e Replay::Run(std::string_view params)
+{
+	int proto;
+	sockaddr_in sa;
+	Client::Framing_e framing;
+	if (auto const res = Client::ParseParams(params, proto, sa, &framing); Res_e::SUCCESS != res) { return res; }
+	auto const begin = chrono::steady_clock::now();
+	auto const res = (IPPROTO_TCP == proto) ? RunTcp(params) : RunUdp(params);
+	m_elapsed = chrono::steady_clock::now() - begin;
+	fflush(m_out);
+	return res;
+}
+
+Client::Res_e Replay::RunTcp(std::string_view params)
+{
+	Client client;
+	client.SetReconnect(true);
+	client.SetWindow(WINDOW);
+	if (auto const res = client.Start(params); Res_e::SUCCESS != res) { return res; }
+	
+	string_view msgs[BATCH_SIZE];
+	Client::Callback callbacks[BATCH_SIZE];
+	string_view request;
+	bool has_more = true;
+	while (has_more)
+	{
+		auto const now = chrono::steady_clock::now();
+		size_t qty = 0;
+		while (qty < BATCH_SIZE and (has_more = NextRequest(request)))
+		{
+			msgs[qty] = request;
+			//answers come in the order of requests, so they are written right from callbacks
+			callbacks[qty] = [this, now](Res_e res, string_view answer)
+			{
+				Record(res, now);
+				Write(res, answer);
+			};
+			++qty;
+		}
+		if (0 == qty) break;
+		
+		auto res = client.Reconnect();
+		for (auto const deadline = now + RECONNECT_WAIT; Res_e::RECONNECTING == res and chrono::steady_clock::now() < deadline; res = client.Reconnect()) {
+			this_thread::sleep_for(chrono::milliseconds(10));
+		}
+		if (Res_e::SUCCESS != res)
+		{
+			Log<LogLevel::ERROR>("Connection to server is not restored, replay is stopped");
+			return res;
+		}
+		//failed requests are reported by their callbacks
+		client.SubmitBatch(msgs, callbacks, qty);
+		client.Poll();
+	}
+	return client.Flush();
+}
+
+void Replay::WriteCompletedUdp()
+{
+	while (not m_udp_slots.empty() and m_udp_slots.front().is_done)
+	{
+		Write(m_udp_slots.front().res, m_udp_slots.front().answer);
+		m_udp_slots.pop_front();
+		++m_udp_first_seq;
+	}
+}
+
+Client::Res_e Replay::RunUdp(std::string_view params)
+{
+	EventLoop loop;
+	loop.SetWindow(UDP_WINDOW);
+	loop.SetUdpMessageId(m_udp_has_msg_id);
+	EventLoop::SessionId id;
+	if (auto const res = loop.AddSession(params, id); Res_e::SUCCESS != res) { return res; }
+	
+	string_view request;
+	bool has_more = NextRequest(request);
+	while (has_more or not m_udp_slots.empty())
+	{
+		auto const now = chrono::steady_clock::now();
+		while (has_more and m_udp_slots.size() < UDP_WINDOW)
+		{
+			size_t const seq = m_udp_first_seq + m_udp_slots.size();
+			m_udp_slots.emplace_back();
+			auto const res = loop.Submit(id, request, [this, seq, now](Res_e res, string_view answer)
+			{
+				UdpSlot& slot = m_udp_slots[seq - m_udp_first_seq];
+				slot.res = res;
+				slot.answer.assign(answer);
+				slot.is_done = true;
+				Record(res, now);
+			});
+			if (Res_e::WINDOW_IS_FULL == res)
+			{
+				m_udp_slots.pop_back();
+				break;
+			}
+			if (Res_e::SUCCESS != res)
+			{
+				m_udp_slots.back().res = res;
+				m_udp_slots.back().is_done = true;
+				Record(res, now);
+			}
+			has_more = NextRequest(request);
+		}
+		WriteCompletedUdp();
+		if (m_udp_slots.empty()) continue;
+		
+		//lost requests are repeated by EventLoop, unanswered ones fail with TIMEOUT by their callbacks
+		if (-1 == loop.RunOnce(100)) return Res_e::FAILURE;
+	}
+	return Res_e::SUCCESS;
+}
+
+void Replay::PrintSummary(std::FILE* out) const
+{
+	auto const snapshot = m_metrics.GetSnapshot();
+	double const seconds = chrono::duration<double>(m_elapsed).count();
+	uint64_t const requests = snapshot.Get(Counter_e::REQUESTS);
+	fprintf(out, "requests %llu failed %llu in %.3f s, %.0f requests/s\n",
+		static_cast<unsigned long long>(requests), static_cast<unsigned long long>(snapshot.Get(Counter_e::FAILED_REQUESTS)),
+		seconds, seconds > 0 ? requests/seconds : 0.0);
+	fprintf(out, "latency us p50 %.1f p90 %.1f p99 %.1f p999 %.1f max %.1f\n",
+		snapshot.RttPercentileNs(0.5)/1000.0, snapshot.RttPercentileNs(0.9)/1000.0, snapshot.RttPercentileNs(0.99)/1000.0,
+		snapshot.RttPercentileNs(0.999)/1000.0, snapshot.RttPercentileNs(1.0)/1000.0);
+}
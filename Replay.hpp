@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <string_view>
+#include "Client.hpp"
+#include "ClientMetrics.hpp"
+
+//Non-interactive mode of protey_client.Requests are lines of memory mapped file, empty lines are skipped.
+//They are sent pipelined: TCP by Client::SubmitBatch, UDP by EventLoop which repeats lost requests.
+//Answers are written to output in the order of requests, every one is followed by '\n',
+//failed request gets empty answer.
+class Replay
+{
+	static constexpr std::size_t BATCH_SIZE = 64;
+	static constexpr std::size_t WINDOW = 256;
+	//every UDP answer may be many datagrams, more of them in flight overflow socket receive buffer and get lost
+	static constexpr std::size_t UDP_WINDOW = 32;
+	//TCP replay waits for reconnect of broken connection no more than this
+	static constexpr std::chrono::seconds RECONNECT_WAIT{10};
+public:
+	~Replay();
+	//answers_path nullptr means stdout
+	bool Open(char const* requests_path, char const* answers_path);
+	//UDP requests carry MESSAGE_ID, so many of them are in flight and lost fragments are asked again.
+	//Without it one request is in flight and request of several fragments is not repeated, see EventLoop
+	void SetUdpMessageId(bool enable) { m_udp_has_msg_id = enable; }
+	Client::Res_e Run(std::string_view params);
+	//requests qty, throughput and latency percentiles
+	void PrintSummary(std::FILE* out) const;
+private:
+	struct UdpSlot
+	{
+		std::string   answer;
+		Client::Res_e res{Client::Res_e::FAILURE};
+		bool          is_done{false};
+	};
+	bool NextRequest(std::string_view& request);
+	void Record(Client::Res_e res, std::chrono::steady_clock::time_point submitted);
+	void Write(Client::Res_e res, std::string_view answer);
+	void WriteCompletedUdp();
+	Client::Res_e RunTcp(std::string_view params);
+	Client::Res_e RunUdp(std::string_view params);
+	
+	char const*   m_data{nullptr};
+	std::size_t   m_size{0};
+	std::size_t   m_pos{0};
+	std::FILE*    m_out{nullptr};
+	ClientMetrics m_metrics;
+	std::chrono::steady_clock::duration m_elapsed{};
+	bool          m_udp_has_msg_id{false};
+	//UDP answers come in any order, they wait here until all previous ones are written.
+	//No more than UDP_WINDOW of them, so one slow request does not let answers pile up
+	std::deque<UdpSlot> m_udp_slots;
+	std::size_t         m_udp_first_seq{0};
+};
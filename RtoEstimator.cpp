@@ -0,0 +1,26 @@
+#include <algorithm>
+#include "RtoEstimator.hpp"
+
+using namespace std;
+
+void RtoEstimator::AddSample(Duration rtt)
+{
+	if (not m_has_sample)
+	{
+		m_srtt = rtt;
+		m_rttvar = rtt/2;
+		m_has_sample = true;
+	}
+	else
+	{
+		Duration const delta = m_srtt > rtt ? m_srtt - rtt : rtt - m_srtt;
+		m_rttvar = (3*m_rttvar + delta)/4;
+		m_srtt = (7*m_srtt + rtt)/8;
+	}
+	m_rto = clamp(m_srtt + 4*m_rttvar, MIN_RTO, MAX_RTO);
+}
+
+RtoEstimator::Duration RtoEstimator::Get(unsigned retransmits) const
+{
+	return retransmits < 16 ? min(m_rto*(1 << retransmits), MAX_RTO) : MAX_RTO;
+}
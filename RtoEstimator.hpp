@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+
+//UDP retransmission timeout from smoothed round trip time and its variation(RFC 6298).
+//Samples are taken only from requests which were not retransmitted, backoff is applied per request
+//so that on lossy path timeout does not stay doubled for lack of samples.
+class RtoEstimator
+{
+public:
+	using Duration = std::chrono::microseconds;
+	static constexpr Duration INITIAL_RTO{200000};
+	static constexpr Duration MIN_RTO{2000};
+	static constexpr Duration MAX_RTO{1000000};
+	
+	void AddSample(Duration rtt);
+	//timeout after given number of retransmissions of the same request
+	Duration Get(unsigned retransmits) const;
+	Duration Get() const { return m_rto; }
+private:
+	Duration m_srtt{0};
+	Duration m_rttvar{0};
+	Duration m_rto{INITIAL_RTO};
+	bool     m_has_sample{false};
+};
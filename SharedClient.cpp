@@ -0,0 +1,209 @@
+#include <cstring>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include "SharedClient.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("SharedClient.cpp: ", args...);
+}
+
+namespace
+{
+	static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t));
+	
+	void FutexWait(atomic<uint32_t>& word, uint32_t value)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+	}
+	
+	void FutexWake(atomic<uint32_t>& word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+}
+
+SharedClient::~SharedClient()
+{
+	Stop();
+}
+
+SharedClient::Res_e SharedClient::Start(std::string_view params)
+{
+	if (not m_is_stopped) return Res_e::ALREADY_STARTED;
+	int proto;
+	sockaddr_in sa;
+	Client::Framing_e framing;
+	if (auto const res = Client::ParseParams(params, proto, sa, &framing); Res_e::SUCCESS != res) { return res; }
+	m_is_pipelined = IPPROTO_TCP == proto;
+	if (auto const res = m_client.Start(params); Res_e::SUCCESS != res) { return res; }
+	
+	m_wake_desc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (-1 == m_wake_desc)
+	{
+		Log<LogLevel::ERROR>("eventfd failed: ", strerror(errno));
+		return Res_e::FAILURE;
+	}
+	m_is_stopped = false;
+	m_thread = thread([this]{ Run(); });
+	return Res_e::SUCCESS;
+}
+
+void SharedClient::Stop()
+{
+	if (m_is_stopped.exchange(true)) return;
+	uint64_t const one = 1;
+	if (-1 == write(m_wake_desc, &one, sizeof(one))) { Log<LogLevel::ERROR>("Wake of I/O thread failed: ", strerror(errno)); }
+	m_thread.join();
+	//requests pushed while I/O thread was stopping
+	while (Request* request = Pop()) { Complete(request, Res_e::NOT_STARTED); }
+	close(m_wake_desc);
+	m_wake_desc = -1;
+}
+
+SharedClient::Res_e SharedClient::SendMsg(std::string_view msg, std::string& answer)
+{
+	if (m_is_stopped.load(memory_order_relaxed)) return Res_e::NOT_STARTED;
+	if (msg.empty()) return Res_e::NO_DATA_TO_SEND;
+	
+	//completion slot lives on caller's stack until I/O thread marks it DONE
+	Request request;
+	request.msg = msg;
+	request.answer = &answer;
+	Push(&request);
+	for (int i = 0; i < SPINS_BEFORE_SLEEP and PENDING == request.state.load(memory_order_acquire); ++i) {
+		this_thread::yield();
+	}
+	uint32_t expected = PENDING;
+	if (request.state.compare_exchange_strong(expected, SLEEPING, memory_order_acq_rel))
+	{
+		while (SLEEPING == request.state.load(memory_order_acquire)) { FutexWait(request.state, SLEEPING); }
+	}
+	return request.res;
+}
+
+void SharedClient::Push(Request* request)
+{
+	request->next.store(nullptr, memory_order_relaxed);
+	Request* const prev = m_head.exchange(request, memory_order_seq_cst);
+	prev->next.store(request, memory_order_release);
+	//I/O thread which decided to sleep is woken, the rest find request by Pop
+	if (m_is_waiting.load(memory_order_seq_cst) and m_is_waiting.exchange(false, memory_order_seq_cst))
+	{
+		uint64_t const one = 1;
+		if (-1 == write(m_wake_desc, &one, sizeof(one))) { Log<LogLevel::ERROR>("Wake of I/O thread failed: ", strerror(errno)); }
+	}
+}
+
+SharedClient::Request* SharedClient::Pop()
+{
+	//Vyukov intrusive MPSC queue, stub node keeps the list never empty
+	Request* tail = m_tail;
+	Request* next = tail->next.load(memory_order_acquire);
+	if (tail == &m_stub)
+	{
+		if (not next) return nullptr;
+		m_tail = tail = next;
+		next = next->next.load(memory_order_acquire);
+	}
+	if (next)
+	{
+		m_tail = next;
+		return tail;
+	}
+	//producer has exchanged head but not linked its request yet
+	if (tail != m_head.load(memory_order_acquire)) return nullptr;
+	Push(&m_stub);
+	next = tail->next.load(memory_order_acquire);
+	if (next)
+	{
+		m_tail = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+bool SharedClient::IsEmpty() const
+{
+	return m_tail == &m_stub and m_head.load(memory_order_seq_cst) == &m_stub;
+}
+
+void SharedClient::Complete(Request* request, Res_e res)
+{
+	request->res = res;
+	//request memory belongs to caller again right after the exchange
+	if (SLEEPING == request->state.exchange(DONE, memory_order_acq_rel)) { FutexWake(request->state); }
+}
+
+void SharedClient::SendBatch()
+{
+	if (not m_is_pipelined)
+	{
+		for (Request* request : m_batch) { Complete(request, m_client.SendMsg(request->msg, *request->answer)); }
+		return;
+	}
+	m_batch_msgs.clear();
+	m_batch_callbacks.clear();
+	for (Request* request : m_batch)
+	{
+		m_batch_msgs.push_back(request->msg);
+		m_batch_callbacks.emplace_back([this, request](Res_e res, string_view answer)
+		{
+			if (Res_e::SUCCESS == res) { request->answer->assign(answer); }
+			Complete(request, res);
+		});
+	}
+	m_client.SubmitBatch(m_batch_msgs.data(), m_batch_callbacks.data(), m_batch.size());
+}
+
+void SharedClient::Wait()
+{
+	//sleep is announced before the last check of the queue, so Push either sees it or its request is found
+	m_is_waiting.store(true, memory_order_seq_cst);
+	if (not IsEmpty() or m_is_stopped.load(memory_order_relaxed))
+	{
+		m_is_waiting.store(false, memory_order_relaxed);
+		return;
+	}
+	pollfd pfds[2] = {{m_wake_desc, POLLIN, 0}, {m_client.GetDesc(), POLLIN, 0}};
+	if (-1 == poll(pfds, m_client.GetInFlight() > 0 ? 2 : 1, -1) and errno != EINTR) {
+		Log<LogLevel::ERROR>("Poll failed: ", strerror(errno));
+	}
+	m_is_waiting.store(false, memory_order_relaxed);
+	if (pfds[0].revents & POLLIN)
+	{
+		uint64_t value;
+		if (-1 == read(m_wake_desc, &value, sizeof(value))) { Log("Wake counter is already read"); }
+	}
+}
+
+void SharedClient::Run()
+{
+	while (1)
+	{
+		//requests queued while the previous batch was on the wire go together
+		m_batch.clear();
+		while (Request* request = Pop()) { m_batch.push_back(request); }
+		if (not m_batch.empty())
+		{
+			Log("Batch of ", m_batch.size(), " requests");
+			SendBatch();
+		}
+		if (m_client.GetInFlight() > 0) { m_client.Poll(); }
+		if (not m_batch.empty()) continue;
+		if (m_is_stopped.load(memory_order_relaxed))
+		{
+			m_client.Flush();
+			return;
+		}
+		Wait();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Client.hpp"
+
+//One Client shared by many threads.Callers push requests into lock-free intrusive MPSC queue
+//and wait in their own completion slots, single I/O thread writes all queued TCP requests by one call
+//and completes them as answers come.UDP requests are sent by I/O thread one by one.
+class SharedClient
+{
+	//caller yields this many times before it sleeps in kernel waiting for answer
+	static constexpr int SPINS_BEFORE_SLEEP = 16;
+public:
+	using Res_e = Client::Res_e;
+	
+	~SharedClient();
+	//options of the client are set before Start, it must not be used directly after that
+	Client& GetClient() { return m_client; }
+	Res_e Start(std::string_view params);
+	//must not be called while other threads are in SendMsg
+	void Stop();
+	//may be called by many threads at once, blocks until answer is written into answer
+	Res_e SendMsg(std::string_view msg, std::string& answer);
+private:
+	enum State_e : uint32_t
+	{
+		PENDING,
+		SLEEPING,//caller waits in futex
+		DONE
+	};
+	struct Request
+	{
+		std::atomic<Request*> next{nullptr};
+		std::string_view      msg;
+		std::string*          answer{nullptr};
+		Res_e                 res{Res_e::FAILURE};
+		std::atomic<uint32_t> state{PENDING};
+	};
+	void Push(Request* request);
+	Request* Pop();
+	bool IsEmpty() const;
+	void Complete(Request* request, Res_e res);
+	void SendBatch();
+	void Wait();
+	void Run();
+	
+	Client                m_client;
+	bool                  m_is_pipelined{false};
+	//producers exchange head, only I/O thread moves tail
+	alignas(64) std::atomic<Request*> m_head{&m_stub};
+	alignas(64) Request*  m_tail{&m_stub};
+	Request               m_stub;
+	std::atomic<bool>     m_is_waiting{false};
+	std::atomic<bool>     m_is_stopped{true};
+	//eventfd which wakes I/O thread sleeping in poll
+	int                   m_wake_desc{-1};
+	std::thread           m_thread;
+	//batch storage of I/O thread is reused
+	std::vector<Request*>         m_batch;
+	std::vector<std::string_view> m_batch_msgs;
+	std::vector<Client::Callback> m_batch_callbacks;
+};
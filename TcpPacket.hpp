@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+//TCP: request and answer are terminated by TCP_LINE_END, answer to digit prefixed request
+//has its second line joined by '\t'
+inline constexpr char TCP_LINE_END = '\n';
+
+//TCPBIN: LENGTH(4 bytes, network byte order) + LENGTH bytes of payload for both request and answer,
+//payload is not scanned or rewritten so it may contain any bytes
+inline constexpr std::string_view tcpbin_proto{"TCPBIN"};
+inline constexpr std::size_t TCP_BIN_HEADER_SIZE = 4;
+//rest of answer body of this size or more is read by recv right into answer, not through RecvBuffer
+inline constexpr std::size_t TCP_BIN_DIRECT_READ_SIZE = 4096;
+//longer answer is taken for broken stream, its connection is closed
+inline constexpr std::size_t TCP_DEFAULT_MAX_ANSWER_SIZE = 64*1024*1024;
@@ -0,0 +1,149 @@
+#include <cstring>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "UdpFragmenter.hpp"
+#include "UdpPacket.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("UdpFragmenter.cpp: ", args...);
+}
+
+//kernel limits for one UDP_SEGMENT send
+constexpr size_t UDP_GSO_MAX_SEGMENTS = 64;
+constexpr size_t UDP_MAX_DATAGRAM_SIZE = 65507;
+//IPv4 header(20 bytes) + UDP header(8 bytes)
+constexpr uint16_t IPv4_UDP_HEADERS_SIZE = 28;
+//every IPv4 host must accept datagrams of this size, used when path MTU is unknown
+constexpr uint16_t IPv4_MIN_MTU = 576;
+
+void UdpFragmenter::Build(std::string_view msg, uint16_t packet_size, uint32_t msg_id, bool gso, sockaddr_in const* sa)
+{
+	uint16_t const header_size = UdpHeaderSize(m_has_msg_id);
+	uint16_t const payload_size = packet_size - header_size;
+	uint16_t packets_qty = msg.size()/payload_size;
+	uint16_t ost = msg.size()%payload_size;
+	if (ost > 0){ ++packets_qty; }
+	m_packets_qty = packets_qty;
+	
+	//every fragment is header iovec + payload iovec pointing right into msg, so payload is not copied
+	m_headers.resize(packets_qty*header_size);
+	m_iovs.resize(packets_qty*2);
+	uint16_t const packets_qty_net = htons(packets_qty);
+	uint16_t const ps_net = htons(packet_size);
+	uint32_t const msg_id_net = htonl(msg_id);
+	for (size_t i = 0; i < packets_qty; ++i)
+	{
+		char* wbuff = &m_headers[i*header_size];
+		memcpy(wbuff, UDP_PACKET_BEGIN.data(), UDP_PACKET_BEGIN.size());
+		memcpy(wbuff + UDP_PH_QTY_POS, &packets_qty_net, sizeof(packets_qty_net));
+		uint16_t seq_num_net = htons(i);
+		memcpy(wbuff + UDP_PH_SEQ_NUM_POS, &seq_num_net, sizeof(seq_num_net));
+		memcpy(wbuff + UDP_PH_SIZE_POS, &ps_net, sizeof(ps_net));
+		if (m_has_msg_id) { memcpy(wbuff + UDP_PH_MSG_ID_POS, &msg_id_net, sizeof(msg_id_net)); }
+
+		size_t payload_len;
+		if (static_cast<size_t>(packets_qty - 1) == i and ost > 0) payload_len = ost;
+		else payload_len = payload_size;
+		
+		m_iovs[i*2] = {wbuff, header_size};
+		m_iovs[i*2 + 1] = {const_cast<char*>(&msg[i*payload_size]), payload_len};
+	}
+	
+	//with GSO one sendmmsg entry carries several fragments and kernel cuts it by packet_size,
+	//only the last fragment may be shorter and it is always the last one in its entry
+	size_t const fragments_per_msg = gso ? min(UDP_GSO_MAX_SEGMENTS, UDP_MAX_DATAGRAM_SIZE/packet_size) : 1;
+	size_t const msgs_qty = (packets_qty + fragments_per_msg - 1)/fragments_per_msg;
+	m_msgs.resize(msgs_qty);
+	for (size_t i = 0; i < msgs_qty; ++i)
+	{
+		msghdr& hdr = m_msgs[i].msg_hdr;
+		hdr = msghdr{};
+		hdr.msg_name = const_cast<sockaddr_in*>(sa);
+		hdr.msg_namelen = sa ? sizeof(*sa) : 0;
+		hdr.msg_iov = &m_iovs[i*fragments_per_msg*2];
+		hdr.msg_iovlen = min<size_t>(fragments_per_msg, packets_qty - i*fragments_per_msg)*2;
+	}
+	m_sa = sa;
+	m_next = 0;
+}
+
+void UdpFragmenter::Select(uint16_t const* seq_nums, std::size_t qty)
+{
+	m_msgs.clear();
+	for (size_t i = 0; i < qty; ++i)
+	{
+		if (seq_nums[i] >= m_packets_qty) continue;
+		msghdr& hdr = m_msgs.emplace_back().msg_hdr;
+		hdr = msghdr{};
+		hdr.msg_name = const_cast<sockaddr_in*>(m_sa);
+		hdr.msg_namelen = m_sa ? sizeof(*m_sa) : 0;
+		hdr.msg_iov = &m_iovs[seq_nums[i]*2];
+		hdr.msg_iovlen = 2;
+	}
+	m_next = 0;
+}
+
+void UdpFragmenter::BuildResend(std::vector<char>& packet, uint32_t msg_id, std::vector<uint16_t> const& seq_nums, uint16_t packet_size)
+{
+	uint16_t const qty = min(seq_nums.size(), UdpResendMaxQty(packet_size));
+	packet.resize(UDP_RESEND_HEADER_SIZE + qty*2);
+	memcpy(packet.data(), UDP_RESEND_BEGIN.data(), UDP_RESEND_BEGIN.size());
+	uint32_t const msg_id_net = htonl(msg_id);
+	memcpy(&packet[UDP_RH_MSG_ID_POS], &msg_id_net, sizeof(msg_id_net));
+	uint16_t const qty_net = htons(qty);
+	memcpy(&packet[UDP_RH_QTY_POS], &qty_net, sizeof(qty_net));
+	for (size_t i = 0; i < qty; ++i)
+	{
+		uint16_t const seq_num_net = htons(seq_nums[i]);
+		memcpy(&packet[UDP_RESEND_HEADER_SIZE + i*2], &seq_num_net, sizeof(seq_num_net));
+	}
+}
+
+int UdpFragmenter::Send(int desc, int flags)
+{
+	unsigned int const vlen = min(m_msgs.size() - m_next, UDP_MMSG_BATCH_SIZE);
+	int const written_msgs = sendmmsg(desc, &m_msgs[m_next], vlen, flags);
+	for (int k = 0; k < written_msgs; ++k, ++m_next)
+	{
+		msghdr const& hdr = m_msgs[m_next].msg_hdr;
+		size_t msg_len = 0;
+		for (size_t j = 0; j < hdr.msg_iovlen; ++j) { msg_len += hdr.msg_iov[j].iov_len; }
+		if (m_msgs[m_next].msg_len != msg_len) {
+			++m_repeated;
+			break;
+		}
+		m_sent_bytes += msg_len;
+	}
+	return written_msgs;
+}
+
+uint16_t UdpFragmenter::DiscoverPacketSize(sockaddr_in const& sa, uint16_t limit)
+{
+	//IP_MTU is available only for connected socket, so separate probe socket is used
+	int mtu = IPv4_MIN_MTU;
+	int const probe = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (-1 != probe)
+	{
+		int const pmtu_mode = IP_PMTUDISC_DO;
+		socklen_t len = sizeof(mtu);
+		if (-1 == setsockopt(probe, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu_mode, sizeof(pmtu_mode))
+			or -1 == connect(probe, (sockaddr const*)&sa, sizeof(sa))
+			or -1 == getsockopt(probe, IPPROTO_IP, IP_MTU, &mtu, &len))
+		{
+			Log<LogLevel::WARNING>("Path MTU discovery failed: ", strerror(errno));
+			mtu = IPv4_MIN_MTU;
+		}
+		close(probe);
+	}
+	Log<LogLevel::INFO>("Path MTU is ", mtu);
+	
+	size_t packet_size = min<size_t>(mtu - IPv4_UDP_HEADERS_SIZE, MAX_UDP_PACKET_SIZE);
+	if (limit > 0) { packet_size = min<size_t>(packet_size, limit); }
+	return max<size_t>(packet_size, UDP_ID_PACKET_HEADER_SIZE + 1);
+}
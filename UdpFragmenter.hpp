@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+//Cuts message into UDP fragments described by mmsghdr array, payload is not copied.
+class UdpFragmenter
+{
+public:
+	//MESSAGE_ID is added to headers only if it is enabled, set before Build
+	void SetMessageId(bool enable) { m_has_msg_id = enable; }
+	//msg and sa must live until all fragments are sent
+	void Build(std::string_view msg, uint16_t packet_size, uint32_t msg_id, bool gso, sockaddr_in const* sa);
+	//sends not yet sent fragments by one sendmmsg call and returns its result,
+	//fragment written partially is sent again by the next call
+	int Send(int desc, int flags);
+	//next Send calls send only fragments with given packet numbers, by one datagram each
+	void Select(uint16_t const* seq_nums, std::size_t qty);
+	bool IsSent() const { return m_next == m_msgs.size(); }
+	uint16_t GetPacketsQty() const { return m_packets_qty; }
+	std::size_t GetRepeated() const { return m_repeated; }
+	//bytes of fully sent datagrams including headers
+	std::size_t GetSentBytes() const { return m_sent_bytes; }
+	
+	//largest packet size allowed by path MTU to sa, limited by limit if it is not 0
+	static uint16_t DiscoverPacketSize(sockaddr_in const& sa, uint16_t limit);
+	//resend request for missing fragments of message, numbers which do not fit one packet_size datagram are not included.
+	//Longer request would be split by UDP_SEGMENT of GSO socket
+	static void BuildResend(std::vector<char>& packet, uint32_t msg_id, std::vector<uint16_t> const& seq_nums, uint16_t packet_size);
+private:
+	std::vector<char>    m_headers;
+	std::vector<iovec>   m_iovs;
+	std::vector<mmsghdr> m_msgs;
+	sockaddr_in const*   m_sa{nullptr};
+	std::size_t          m_next{0};
+	std::size_t          m_repeated{0};
+	std::size_t          m_sent_bytes{0};
+	uint16_t             m_packets_qty{0};
+	bool                 m_has_msg_id{false};
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+//UDP_PACKET_BEGIN(12 bytes) + PACKETS_QTY(2 bytes) + PACKET_NUMBER(2 bytes) + PACKET_SIZE(2 bytes)
+//optionally followed by MESSAGE_ID(4 bytes), it is used only with servers configured for it and they echo it in answers.
+//all numbers are in network byte order
+inline constexpr std::string_view UDP_PACKET_BEGIN {"proteyclient"};
+
+inline constexpr uint16_t UDP_PH_QTY_POS            = UDP_PACKET_BEGIN.size();
+inline constexpr uint16_t UDP_PH_SEQ_NUM_POS        = UDP_PH_QTY_POS + 2;
+inline constexpr uint16_t UDP_PH_SIZE_POS           = UDP_PH_SEQ_NUM_POS + 2;
+inline constexpr uint16_t UDP_PACKET_HEADER_SIZE    = UDP_PH_SIZE_POS + 2;
+inline constexpr uint16_t UDP_PH_MSG_ID_POS         = UDP_PACKET_HEADER_SIZE;
+inline constexpr uint16_t UDP_ID_PACKET_HEADER_SIZE = UDP_PH_MSG_ID_POS + 4;
+
+inline constexpr uint16_t UdpHeaderSize(bool has_msg_id) { return has_msg_id ? UDP_ID_PACKET_HEADER_SIZE : UDP_PACKET_HEADER_SIZE; }
+
+//UDP_RESEND_BEGIN(12 bytes) + MESSAGE_ID(4 bytes) + QTY(2 bytes) + QTY*PACKET_NUMBER(2 bytes each)
+//is sent by receiver of incomplete message to ask for its missing fragments
+inline constexpr std::string_view UDP_RESEND_BEGIN {"proteyresend"};
+
+inline constexpr uint16_t UDP_RH_MSG_ID_POS      = UDP_RESEND_BEGIN.size();
+inline constexpr uint16_t UDP_RH_QTY_POS         = UDP_RH_MSG_ID_POS + 4;
+inline constexpr uint16_t UDP_RESEND_HEADER_SIZE = UDP_RH_QTY_POS + 2;
+//packet numbers which fit one resend request of packet_size bytes
+inline constexpr std::size_t UdpResendMaxQty(uint16_t packet_size) { return (packet_size - UDP_RESEND_HEADER_SIZE)/2; }
+
+//datagram size of servers which do not expect larger fragments, it is the default one
+inline constexpr uint16_t UDP_LEGACY_PACKET_SIZE = 64;
+//Ethernet MTU 1500 minus IPv4 and UDP headers
+inline constexpr std::size_t MAX_UDP_PACKET_SIZE = 1472;
+
+//how many datagrams are passed to kernel by one sendmmsg/recvmmsg call
+inline constexpr std::size_t UDP_MMSG_BATCH_SIZE = 64;
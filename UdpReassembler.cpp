@@ -0,0 +1,124 @@
+#include <cstring>
+#include <arpa/inet.h>
+#include "UdpReassembler.hpp"
+#include "UdpPacket.hpp"
+
+using namespace std;
+
+UdpReassembler::Message* UdpReassembler::Find(uint32_t msg_id)
+{
+	for (auto& msg : m_messages)
+	{
+		if (msg.answer and msg.id == msg_id) return &msg;
+	}
+	return nullptr;
+}
+
+void UdpReassembler::Expect(uint32_t msg_id, std::string& answer)
+{
+	Message* msg = Find(msg_id);
+	if (not msg)
+	{
+		for (auto& free_msg : m_messages)
+		{
+			if (not free_msg.answer) { msg = &free_msg; break; }
+		}
+		if (not msg) { msg = &m_messages.emplace_back(); }
+		++m_in_flight;
+	}
+	msg->id = msg_id;
+	msg->answer = &answer;
+	m_last_expected = msg_id;
+	msg->qty = 0;
+	msg->received = 0;
+	msg->packet_size = 0;
+}
+
+void UdpReassembler::Forget(uint32_t msg_id)
+{
+	if (Message* msg = Find(msg_id))
+	{
+		msg->answer = nullptr;
+		--m_in_flight;
+	}
+}
+
+bool UdpReassembler::GetMissing(uint32_t msg_id, std::vector<uint16_t>& missing, std::size_t max_qty)
+{
+	Message const* msg = Find(msg_id);
+	if (not msg or 0 == msg->received) return false;
+	missing.clear();
+	for (uint16_t seq_num = 0; seq_num < msg->qty and missing.size() < max_qty; ++seq_num)
+	{
+		if (not (msg->seen[seq_num/64] & (uint64_t{1} << (seq_num%64)))) { missing.push_back(seq_num); }
+	}
+	return true;
+}
+
+UdpReassembler::Res_e UdpReassembler::Add(char const* packet, std::size_t size, uint32_t& msg_id)
+{
+	uint16_t const header_size = UdpHeaderSize(m_has_msg_id);
+	if (size < header_size or string_view{packet, UDP_PACKET_BEGIN.size()} != UDP_PACKET_BEGIN)
+	{
+		return Res_e::FOREIGN;
+	}
+	
+	uint16_t qty, seq_num, packet_size;
+	memcpy(&qty, packet + UDP_PH_QTY_POS, sizeof(qty));
+	memcpy(&seq_num, packet + UDP_PH_SEQ_NUM_POS, sizeof(seq_num));
+	memcpy(&packet_size, packet + UDP_PH_SIZE_POS, sizeof(packet_size));
+	qty = ntohs(qty);
+	seq_num = ntohs(seq_num);
+	packet_size = ntohs(packet_size);
+	if (m_has_msg_id)
+	{
+		memcpy(&msg_id, packet + UDP_PH_MSG_ID_POS, sizeof(msg_id));
+		msg_id = ntohl(msg_id);
+	}
+	else msg_id = m_last_expected;
+	
+	Message* msg = Find(msg_id);
+	if (not msg) return Res_e::FOREIGN;
+	
+	if (0 == qty or seq_num >= qty or packet_size <= header_size or packet_size > MAX_UDP_PACKET_SIZE or size > packet_size)
+	{
+		return Res_e::DAMAGED;
+	}
+	//all but the last fragment are exactly packet_size long
+	if (seq_num != (qty - 1) and size != packet_size) return Res_e::DAMAGED;
+	
+	size_t const payload_size = packet_size - header_size;
+	if (0 == msg->received)
+	{
+		//all fragments but the last one are full, so this is the shortest possible answer
+		if ((qty - 1)*payload_size + 1 > m_max_answer_size) return Res_e::DAMAGED;
+		msg->qty = qty;
+		msg->packet_size = packet_size;
+		msg->seen.assign((qty + 63)/64, 0);
+		//room for full size last fragment, it is cut to real size on completion
+		msg->answer->resize(qty*payload_size);
+	}
+	else if (qty != msg->qty or packet_size != msg->packet_size)
+	{
+		return Res_e::DAMAGED;
+	}
+	
+	if (seq_num == (qty - 1) and seq_num*payload_size + size - header_size > m_max_answer_size) return Res_e::DAMAGED;
+	
+	uint64_t& word = msg->seen[seq_num/64];
+	uint64_t const bit = uint64_t{1} << (seq_num%64);
+	if (word & bit) return Res_e::DUPLICATED;
+	word |= bit;
+	
+	memcpy(&(*msg->answer)[seq_num*payload_size], packet + header_size, size - header_size);
+	if (seq_num == (qty - 1))
+	{
+		msg->answer->resize(seq_num*payload_size + size - header_size);
+	}
+	
+	if (++msg->received != msg->qty) return Res_e::FRAGMENT_ADDED;
+	
+	msg->answer = nullptr;
+	--m_in_flight;
+	return Res_e::MESSAGE_COMPLETED;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Collects fragments of UDP answers into caller's buffers.
+//With MESSAGE_ID header several messages may be in flight at once, fragments are matched to them by it.
+//Without it fragments belong to the message expected last.
+class UdpReassembler
+{
+	static constexpr std::size_t DEFAULT_MAX_ANSWER_SIZE = 4*1024*1024;
+public:
+	enum class Res_e : uint8_t
+	{
+		FRAGMENT_ADDED,
+		MESSAGE_COMPLETED,
+		DUPLICATED,
+		DAMAGED,
+		FOREIGN
+	};
+	//headers of fragments carry MESSAGE_ID, set before the first Expect
+	void SetMessageId(bool enable) { m_has_msg_id = enable; }
+	//fragments of longer answers are DAMAGED, so one forged fragment can not make huge allocation
+	void SetMaxAnswerSize(std::size_t size) { m_max_answer_size = size; }
+	//answer must live until message is completed or forgotten
+	void Expect(uint32_t msg_id, std::string& answer);
+	void Forget(uint32_t msg_id);
+	//msg_id is set for every result except DAMAGED and FOREIGN packets without valid header
+	Res_e Add(char const* packet, std::size_t size, uint32_t& msg_id);
+	std::size_t InFlight() const { return m_in_flight; }
+	//up to max_qty first packet numbers not received yet, false if message is not expected or none of its fragments is received
+	bool GetMissing(uint32_t msg_id, std::vector<uint16_t>& missing, std::size_t max_qty);
+private:
+	struct Message
+	{
+		uint32_t              id{0};
+		std::string*          answer{nullptr};
+		uint16_t              qty{0};
+		uint16_t              received{0};
+		uint16_t              packet_size{0};
+		std::vector<uint64_t> seen;
+	};
+	Message* Find(uint32_t msg_id);
+	
+	//slots are reused so steady state does not allocate
+	std::vector<Message> m_messages;
+	std::size_t          m_in_flight{0};
+	std::size_t          m_max_answer_size{DEFAULT_MAX_ANSWER_SIZE};
+	bool                 m_has_msg_id{false};
+	uint32_t             m_last_expected{0};
+};
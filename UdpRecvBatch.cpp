@@ -0,0 +1,31 @@
+#include <errno.h>
+#include "UdpRecvBatch.hpp"
+
+using namespace std;
+
+int UdpRecvBatch::Recv(int desc)
+{
+	m_buffer.resize(UDP_MMSG_BATCH_SIZE*MAX_UDP_PACKET_SIZE);
+	//headers are filled every time, so the object may be moved between reads
+	for (size_t k = 0; k < UDP_MMSG_BATCH_SIZE; ++k)
+	{
+		m_iovs[k] = {&m_buffer[k*MAX_UDP_PACKET_SIZE], MAX_UDP_PACKET_SIZE};
+		m_msgs[k].msg_hdr = msghdr{};
+		m_msgs[k].msg_hdr.msg_iov = &m_iovs[k];
+		m_msgs[k].msg_hdr.msg_iovlen = 1;
+		m_msgs[k].msg_hdr.msg_name = &m_peers[k];
+		m_msgs[k].msg_hdr.msg_namelen = sizeof(m_peers[k]);
+	}
+	return recvmmsg(desc, m_msgs, UDP_MMSG_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+}
+
+std::size_t UdpRecvBatch::Drop(int desc)
+{
+	size_t dropped = 0;
+	int read_packets;
+	while ((read_packets = Recv(desc)) > 0 or (-1 == read_packets and errno == EINTR))
+	{
+		if (read_packets > 0) { dropped += read_packets; }
+	}
+	return dropped;
+}
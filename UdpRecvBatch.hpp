@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "UdpPacket.hpp"
+
+//Datagrams read by one recvmmsg call, up to UDP_MMSG_BATCH_SIZE of MAX_UDP_PACKET_SIZE each.
+//Storage is allocated by the first read and reused, sender address is kept for every datagram.
+class UdpRecvBatch
+{
+public:
+	//number of read datagrams, -1 with errno like recvmmsg.Does not block
+	int Recv(int desc);
+	//discards datagrams queued on socket, returns their number
+	std::size_t Drop(int desc);
+	char const* GetData(std::size_t k) const { return static_cast<char const*>(m_iovs[k].iov_base); }
+	std::size_t GetSize(std::size_t k) const { return m_msgs[k].msg_len; }
+	bool IsTruncated(std::size_t k) const { return m_msgs[k].msg_hdr.msg_flags & MSG_TRUNC; }
+	sockaddr_in const& GetPeer(std::size_t k) const { return m_peers[k]; }
+private:
+	std::vector<char> m_buffer;
+	iovec             m_iovs[UDP_MMSG_BATCH_SIZE];
+	mmsghdr           m_msgs[UDP_MMSG_BATCH_SIZE];
+	sockaddr_in       m_peers[UDP_MMSG_BATCH_SIZE];
+};
@@ -0,0 +1,50 @@
+#include "UdpRequestTimer.hpp"
+
+using namespace std;
+
+void UdpRequestTimer::Start(Clock::time_point deadline, bool has_msg_id)
+{
+	*this = UdpRequestTimer{};
+	m_deadline = deadline;
+	m_has_msg_id = has_msg_id;
+}
+
+void UdpRequestTimer::OnSent(Clock::time_point now, RtoEstimator const& rto)
+{
+	m_sent = now;
+	if (m_has_msg_id) { m_retransmit_at = now + rto.Get(m_retransmits); }
+}
+
+void UdpRequestTimer::OnProgress(Clock::time_point now, RtoEstimator& rto)
+{
+	//timer runs only for completely sent request, time to the first fragment of its answer
+	//is round trip sample unless it may be answer to repeated request
+	if (m_retransmit_at != Clock::time_point::max())
+	{
+		if (not m_is_answering and 0 == m_retransmits) {
+			rto.AddSample(chrono::duration_cast<RtoEstimator::Duration>(now - m_sent));
+		}
+		m_retransmit_at = now + rto.Get(m_retransmits);
+	}
+	m_is_answering = true;
+	m_is_resend_asked = false;
+}
+
+UdpRequestTimer::Action_e UdpRequestTimer::OnTimer(Clock::time_point now, RtoEstimator const& rto, UdpReassembler& reassembler,
+	uint32_t msg_id, std::vector<uint16_t>& missing, std::size_t max_missing)
+{
+	if (now >= m_deadline) return Action_e::TIMEOUT;
+	if (now < m_retransmit_at) return Action_e::WAIT;
+
+	//server which does not support resend requests does not answer them, whole request is sent next time
+	m_is_resend_asked = not m_is_resend_asked and reassembler.GetMissing(msg_id, missing, max_missing);
+	++m_retransmits;
+	if (m_is_resend_asked)
+	{
+		m_retransmit_at = now + rto.Get(m_retransmits);
+		return Action_e::ASK_RESEND;
+	}
+	//timer restarts when request is sent
+	m_retransmit_at = Clock::time_point::max();
+	return Action_e::SEND_AGAIN;
+}
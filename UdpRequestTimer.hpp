@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "RtoEstimator.hpp"
+#include "UdpReassembler.hpp"
+
+//Retransmission policy of one UDP request, the same for Client and EventLoop.
+//Timer starts when request is completely sent and restarts on every new fragment of answer,
+//so only silence of server leads to retransmission.Missing fragments of answer are asked
+//by resend request, otherwise the whole request is sent again.Without MESSAGE_ID late answer of repeated
+//request can not be told from answer of the next one, so request is not repeated and waits for its deadline.
+class UdpRequestTimer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	enum class Action_e : uint8_t
+	{
+		WAIT,
+		ASK_RESEND,//fragments listed in missing are asked
+		SEND_AGAIN,//OnSent is expected once request is sent
+		TIMEOUT
+	};
+
+	void Start(Clock::time_point deadline, bool has_msg_id);
+	void OnSent(Clock::time_point now, RtoEstimator const& rto);
+	//new fragment of answer
+	void OnProgress(Clock::time_point now, RtoEstimator& rto);
+	//missing gets up to max_missing numbers for resend request
+	Action_e OnTimer(Clock::time_point now, RtoEstimator const& rto, UdpReassembler& reassembler, uint32_t msg_id,
+		std::vector<uint16_t>& missing, std::size_t max_missing);
+	//time of the next OnTimer action
+	Clock::time_point GetNext() const { return std::min(m_retransmit_at, m_deadline); }
+private:
+	Clock::time_point m_deadline{Clock::time_point::max()};
+	Clock::time_point m_sent;
+	Clock::time_point m_retransmit_at{Clock::time_point::max()};
+	unsigned          m_retransmits{0};
+	bool              m_has_msg_id{false};
+	bool              m_is_answering{false};
+	bool              m_is_resend_asked{false};
+};
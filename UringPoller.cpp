@@ -0,0 +1,237 @@
+#include <cstring>
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "UringPoller.hpp"
+#include "AsyncLog.hpp"
+
+using namespace std;
+
+template<LogLevel level = LogLevel::DEBUG, class ... Args>
+void Log(Args const& ... args)
+{
+	AsyncLogPush<level>("UringPoller.cpp: ", args...);
+}
+
+//user_data of requests which completions are not interesting(poll removal)
+constexpr uint64_t IGNORED_USER_DATA = 0;
+
+UringPoller::~UringPoller()
+{
+	if (m_sqes) { munmap(m_sqes, m_sqes_size); }
+	if (m_cq_ring and m_cq_ring != m_sq_ring) { munmap(m_cq_ring, m_cq_ring_size); }
+	if (m_sq_ring) { munmap(m_sq_ring, m_sq_ring_size); }
+	if (-1 != m_desc) { close(m_desc); }
+}
+
+bool UringPoller::Init()
+{
+	io_uring_params params{};
+	m_desc = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+	if (-1 == m_desc)
+	{
+		Log<LogLevel::WARNING>("io_uring is not available: ", strerror(errno));
+		return false;
+	}
+	//timeout of wait is passed to io_uring_enter directly, it is supported since 5.11
+	if (not (params.features & IORING_FEAT_EXT_ARG))
+	{
+		Log<LogLevel::WARNING>("io_uring does not support IORING_FEAT_EXT_ARG");
+		return false;
+	}
+	
+	m_sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+	m_cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		m_sq_ring_size = m_cq_ring_size = max(m_sq_ring_size, m_cq_ring_size);
+	}
+	m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_desc, IORING_OFF_SQ_RING);
+	if (MAP_FAILED == m_sq_ring)
+	{
+		m_sq_ring = nullptr;
+		Log<LogLevel::ERROR>("Mapping of io_uring submission queue failed: ", strerror(errno));
+		return false;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		m_cq_ring = m_sq_ring;
+	}
+	else
+	{
+		m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_desc, IORING_OFF_CQ_RING);
+		if (MAP_FAILED == m_cq_ring)
+		{
+			m_cq_ring = nullptr;
+			Log<LogLevel::ERROR>("Mapping of io_uring completion queue failed: ", strerror(errno));
+			return false;
+		}
+	}
+	m_sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+	void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_desc, IORING_OFF_SQES);
+	if (MAP_FAILED == sqes)
+	{
+		Log<LogLevel::ERROR>("Mapping of io_uring submission entries failed: ", strerror(errno));
+		return false;
+	}
+	m_sqes = static_cast<io_uring_sqe*>(sqes);
+	
+	char* sq = static_cast<char*>(m_sq_ring);
+	m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	m_sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	m_sq_entries = params.sq_entries;
+	char* cq = static_cast<char*>(m_cq_ring);
+	m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	m_cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	return true;
+}
+
+int UringPoller::Enter(unsigned min_complete, int timeout_ms)
+{
+	unsigned flags = IORING_ENTER_GETEVENTS;
+	io_uring_getevents_arg arg{};
+	__kernel_timespec ts{};
+	if (timeout_ms >= 0)
+	{
+		ts.tv_sec = timeout_ms/1000;
+		ts.tv_nsec = (timeout_ms%1000)*1000000LL;
+		arg.ts = reinterpret_cast<uint64_t>(&ts);
+	}
+	flags |= IORING_ENTER_EXT_ARG;
+	int const res = syscall(__NR_io_uring_enter, m_desc, m_to_submit, min_complete, flags, &arg, sizeof(arg));
+	if (res >= 0) { m_to_submit -= min<unsigned>(res, m_to_submit); }
+	return res;
+}
+
+io_uring_sqe* UringPoller::GetSqe()
+{
+	unsigned const tail = *m_sq_tail;
+	if (tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) == m_sq_entries)
+	{
+		//submission queue is full, pass it to kernel without waiting for completions
+		if (-1 == Enter(0, 0)) return nullptr;
+	}
+	unsigned const index = tail & *m_sq_mask;
+	io_uring_sqe* sqe = &m_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	m_sq_array[index] = index;
+	__atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++m_to_submit;
+	return sqe;
+}
+
+void UringPoller::Arm(Registration& reg)
+{
+	if (reg.is_armed or reg.is_removed) return;
+	io_uring_sqe* sqe = GetSqe();
+	if (not sqe)
+	{
+		Log<LogLevel::ERROR>("No room in io_uring for socket ", reg.fd);
+		return;
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = reg.fd;
+	sqe->poll32_events = reg.events;
+	sqe->user_data = reinterpret_cast<uint64_t>(&reg);
+	reg.is_armed = true;
+}
+
+void UringPoller::Cancel(Registration& reg)
+{
+	io_uring_sqe* sqe = GetSqe();
+	if (not sqe) return;
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->addr = reinterpret_cast<uint64_t>(&reg);
+	sqe->user_data = IGNORED_USER_DATA;
+}
+
+bool UringPoller::Add(int fd, uint32_t events, void* ctx)
+{
+	auto& reg = m_registrations[fd];
+	if (reg)
+	{
+		Log<LogLevel::ERROR>("Socket ", fd, " is already added to io_uring");
+		return false;
+	}
+	reg.reset(new Registration{fd, events, ctx});
+	m_to_arm.push_back(fd);
+	return true;
+}
+
+bool UringPoller::Modify(int fd, uint32_t events, void* ctx)
+{
+	auto it = m_registrations.find(fd);
+	if (it == m_registrations.end()) return false;
+	Registration& reg = *it->second;
+	reg.ctx = ctx;
+	if (reg.events == events) return true;
+	reg.events = events;
+	//armed request is cancelled and armed again with new events after its completion
+	if (reg.is_armed) { Cancel(reg); }
+	else { m_to_arm.push_back(fd); }
+	return true;
+}
+
+void UringPoller::Remove(int fd)
+{
+	auto it = m_registrations.find(fd);
+	if (it == m_registrations.end()) return;
+	it->second->is_removed = true;
+	if (it->second->is_armed)
+	{
+		Cancel(*it->second);
+		m_removed.push_back(move(it->second));
+	}
+	m_registrations.erase(it);
+}
+
+int UringPoller::Wait(Event* events, int max_events, int timeout_ms)
+{
+	for (int fd : m_to_arm)
+	{
+		if (auto it = m_registrations.find(fd); it != m_registrations.end()) { Arm(*it->second); }
+	}
+	m_to_arm.clear();
+	
+	unsigned head = *m_cq_head;
+	bool const has_completions = head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+	if (m_to_submit > 0 or not has_completions)
+	{
+		unsigned const min_complete = (has_completions or 0 == timeout_ms) ? 0 : 1;
+		if (-1 == Enter(min_complete, timeout_ms) and errno != ETIME and errno != EINTR)
+		{
+			Log<LogLevel::ERROR>("io_uring_enter failed: ", strerror(errno));
+			return -1;
+		}
+	}
+	
+	int res = 0;
+	unsigned const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail and res < max_events; ++head)
+	{
+		io_uring_cqe const& cqe = m_cqes[head & *m_cq_mask];
+		if (IGNORED_USER_DATA == cqe.user_data) continue;
+		Registration* reg = reinterpret_cast<Registration*>(cqe.user_data);
+		reg->is_armed = false;
+		if (reg->is_removed)
+		{
+			auto it = find_if(m_removed.begin(), m_removed.end(), [reg](auto const& r){ return r.get() == reg; });
+			if (it != m_removed.end()) { m_removed.erase(it); }
+			continue;
+		}
+		m_to_arm.push_back(reg->fd);
+		//-ECANCELED is completion of request cancelled by Modify
+		if (-ECANCELED == cqe.res) continue;
+		events[res].ctx = reg->ctx;
+		events[res].events = (cqe.res < 0) ? POLLERR : static_cast<uint32_t>(cqe.res);
+		++res;
+	}
+	__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+	return res;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <linux/io_uring.h>
+#include "Poller.hpp"
+
+//io_uring backend without liburing.Every socket has one shot IORING_OP_POLL_ADD request
+//which is armed again after completion, that gives level triggered behavior like epoll.
+class UringPoller : public Poller
+{
+	static constexpr unsigned RING_ENTRIES = 1024;
+public:
+	~UringPoller() override;
+	bool Init();
+	bool Add(int fd, uint32_t events, void* ctx) override;
+	bool Modify(int fd, uint32_t events, void* ctx) override;
+	void Remove(int fd) override;
+	int Wait(Event* events, int max_events, int timeout_ms) override;
+private:
+	struct Registration
+	{
+		int      fd;
+		uint32_t events;
+		void*    ctx;
+		bool     is_armed{false};
+		bool     is_removed{false};
+	};
+	io_uring_sqe* GetSqe();
+	void Arm(Registration& reg);
+	void Cancel(Registration& reg);
+	int Enter(unsigned min_complete, int timeout_ms);
+	
+	int           m_desc{-1};
+	void*         m_sq_ring{nullptr};
+	std::size_t   m_sq_ring_size{0};
+	void*         m_cq_ring{nullptr};
+	std::size_t   m_cq_ring_size{0};
+	io_uring_sqe* m_sqes{nullptr};
+	std::size_t   m_sqes_size{0};
+	unsigned*     m_sq_head;
+	unsigned*     m_sq_tail;
+	unsigned*     m_sq_mask;
+	unsigned*     m_sq_array;
+	unsigned      m_sq_entries;
+	unsigned*     m_cq_head;
+	unsigned*     m_cq_tail;
+	unsigned*     m_cq_mask;
+	io_uring_cqe* m_cqes;
+	unsigned      m_to_submit{0};
+	
+	std::unordered_map<int, std::unique_ptr<Registration>> m_registrations;
+	//removed registrations live until completion of their poll request
+	std::vector<std::unique_ptr<Registration>> m_removed;
+	//sockets which poll request has to be armed before waiting
+	std::vector<int> m_to_arm;
+};
@@ -0,0 +1,70 @@
+//Counts heap allocations per request of Client::SendMsg after warm up, they are expected to be 0.
+//Usage: alloc_bench [requests per case]
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "Client.hpp"
+#include "LoopbackServer.hpp"
+
+using namespace std;
+
+//only allocations of the thread calling Client are counted, server thread has its own counter
+static thread_local uint64_t allocations = 0;
+
+void* operator new(size_t size)
+{
+	++allocations;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main(int argc, char** argv)
+{
+	size_t const requests_qty = argc > 1 ? atoi(argv[1]) : 10000;
+	LoopbackServer server;
+	server.SetUdpMessageId(true);
+	if (not server.Start())
+	{
+		cerr << "Server start failed\n";
+		return 1;
+	}
+	
+	cout << "proto\tsize\trequests\tallocations\tper_request\n";
+	bool is_allocating = false;
+	for (string const proto : {"TCP", "UDP"})
+	{
+		for (size_t msg_size : {16, 1024, 64*1024})
+		{
+			Client client;
+			client.SetUdpPacketSize(0);
+			client.SetUdpMessageId(true);
+			if (Client::Res_e::SUCCESS != client.Start(proto + ",127.0.0.1," + to_string(server.GetPort())))
+			{
+				cerr << "Client start failed\n";
+				return 1;
+			}
+			string const msg(msg_size, 'x');
+			string answer;
+			//first requests grow reused buffers up to message size
+			for (size_t i = 0; i < 10; ++i) { client.SendMsg(msg, answer); }
+			
+			uint64_t const before = allocations;
+			for (size_t i = 0; i < requests_qty; ++i)
+			{
+				if (Client::Res_e::SUCCESS != client.SendMsg(msg, answer) or answer.size() != msg_size)
+				{
+					cerr << "Request failed\n";
+					return 1;
+				}
+			}
+			uint64_t const qty = allocations - before;
+			is_allocating = is_allocating or qty > 0;
+			cout << proto << '\t' << msg_size << '\t' << requests_qty << '\t' << qty << '\t' << static_cast<double>(qty)/requests_qty << endl;
+		}
+	}
+	return is_allocating ? 2 : 0;
+}
@@ -0,0 +1,135 @@
+//Latency and throughput of Client against in-process LoopbackServer.
+//Every thread has its own Client or all threads share one SharedClient, they send requests synchronously for the given time.
+//UDP is measured with unconnected and connected sockets.
+//Usage: client_bench [milliseconds per case] [UDP loss rate]
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Client.hpp"
+#include "SharedClient.hpp"
+#include "LoopbackServer.hpp"
+
+using namespace std;
+
+struct ThreadResult
+{
+	vector<uint64_t> latencies_ns;
+	uint64_t         syscalls_qty{0};
+	size_t           errors{0};
+};
+
+//thread uses shared client if it is set, own Client otherwise
+void RunThread(string const& params, SharedClient* shared, bool is_udp_connected, size_t msg_size, chrono::steady_clock::time_point end, ThreadResult& result)
+{
+	Client client;
+	client.SetUdpConnected(is_udp_connected);
+	//LoopbackServer accepts datagrams of path MTU size and MESSAGE_ID header
+	client.SetUdpPacketSize(0);
+	client.SetUdpMessageId(true);
+	if (not shared and Client::Res_e::SUCCESS != client.Start(params))
+	{
+		++result.errors;
+		return;
+	}
+	string const msg(msg_size, 'x');
+	string answer;
+	while (chrono::steady_clock::now() < end)
+	{
+		auto const begin = chrono::steady_clock::now();
+		auto const res = shared ? shared->SendMsg(msg, answer) : client.SendMsg(msg, answer);
+		auto const finish = chrono::steady_clock::now();
+		if (Client::Res_e::SUCCESS != res or answer != msg)
+		{
+			++result.errors;
+			continue;
+		}
+		result.latencies_ns.push_back(chrono::duration_cast<chrono::nanoseconds>(finish - begin).count());
+	}
+	if (not shared) { result.syscalls_qty = client.GetMetrics().Get(ClientMetrics::Counter_e::SYSCALLS); }
+}
+
+double PercentileUs(vector<uint64_t> const& sorted, double p)
+{
+	if (sorted.empty()) return 0;
+	size_t const index = min(sorted.size() - 1, static_cast<size_t>(p*sorted.size()));
+	return sorted[index]/1000.0;
+}
+
+void RunCase(string const& proto, uint16_t port, bool is_shared, bool is_udp_connected, size_t msg_size, size_t threads_qty, chrono::milliseconds duration)
+{
+	string const params = proto + ",127.0.0.1," + to_string(port);
+	SharedClient shared;
+	if (is_shared and Client::Res_e::SUCCESS != shared.Start(params))
+	{
+		cerr << "Shared client start failed\n";
+		return;
+	}
+	vector<ThreadResult> results(threads_qty);
+	vector<thread> threads;
+	auto const begin = chrono::steady_clock::now();
+	auto const end = begin + duration;
+	for (auto& result : results) { threads.emplace_back(RunThread, cref(params), is_shared ? &shared : nullptr, is_udp_connected, msg_size, end, ref(result)); }
+	for (auto& t : threads) { t.join(); }
+	double const seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	
+	vector<uint64_t> latencies;
+	uint64_t syscalls_qty = is_shared ? shared.GetClient().GetMetrics().Get(ClientMetrics::Counter_e::SYSCALLS) : 0;
+	size_t errors = 0;
+	for (auto const& result : results)
+	{
+		latencies.insert(latencies.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+		syscalls_qty += result.syscalls_qty;
+		errors += result.errors;
+	}
+	sort(latencies.begin(), latencies.end());
+	size_t const msgs = max<size_t>(latencies.size(), 1);
+	cout << proto << (is_shared ? "/shared" : "") << (is_udp_connected ? "/connected" : "") << '\t' << msg_size << '\t' << threads_qty << '\t'
+		<< latencies.size()/seconds << '\t'
+		<< PercentileUs(latencies, 0.5) << '\t' << PercentileUs(latencies, 0.99) << '\t' << PercentileUs(latencies, 0.999) << '\t'
+		<< static_cast<double>(syscalls_qty)/msgs << '\t' << errors << endl;
+}
+
+int main(int argc, char** argv)
+{
+	chrono::milliseconds const duration{argc > 1 ? atoi(argv[1]) : 500};
+	LoopbackServer server;
+	server.SetLossRate(argc > 2 ? atof(argv[2]) : 0);
+	server.SetUdpMessageId(true);
+	LoopbackServer bin_server;
+	bin_server.SetTcpBinary(true);
+	if (not server.Start() or not bin_server.Start())
+	{
+		cerr << "Server start failed\n";
+		return 1;
+	}
+	
+	cout << "proto\tsize\tthreads\tmsgs_per_sec\tp50_us\tp99_us\tp999_us\tsyscalls_per_msg\terrors\n";
+	cout << fixed << setprecision(1);
+	for (string const proto : {"TCP", "TCPBIN", "UDP"})
+	{
+		uint16_t const port = ("TCPBIN" == proto) ? bin_server.GetPort() : server.GetPort();
+		for (size_t msg_size : {16, 1024, 16*1024, 64*1024})
+		{
+			for (size_t threads_qty : {1, 4, 16}) { RunCase(proto, port, false, false, msg_size, threads_qty, duration); }
+		}
+	}
+	for (size_t msg_size : {16, 1024, 16*1024, 64*1024})
+	{
+		for (size_t threads_qty : {1, 4, 16}) { RunCase("UDP", server.GetPort(), false, true, msg_size, threads_qty, duration); }
+	}
+	//many threads over one connection
+	for (string const proto : {"TCP", "TCPBIN"})
+	{
+		uint16_t const port = ("TCPBIN" == proto) ? bin_server.GetPort() : server.GetPort();
+		for (size_t msg_size : {16, 1024, 16*1024})
+		{
+			for (size_t threads_qty : {4, 16, 64}) { RunCase(proto, port, true, false, msg_size, threads_qty, duration); }
+		}
+	}
+	return 0;
+}
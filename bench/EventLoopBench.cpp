@@ -0,0 +1,84 @@
+//Measures how many TCP sessions one EventLoop thread drives and how many requests per second it completes.
+//Server is in-process LoopbackServer.
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <sys/resource.h>
+#include "EventLoop.hpp"
+#include "LoopbackServer.hpp"
+
+using namespace std;
+
+//returns completed requests per second, every session keeps depth requests in flight
+double Run(Poller::Type_e type, uint16_t port, size_t sessions_qty, size_t depth, chrono::milliseconds duration)
+{
+	EventLoop loop(type);
+	if (not loop.IsValid()) return -1;
+	loop.SetWindow(depth);
+	
+	string const params = "TCP,127.0.0.1," + to_string(port);
+	string const msg(64, 'x');
+	vector<EventLoop::SessionId> ids(sessions_qty);
+	size_t completed = 0;
+	bool is_running = true;
+	function<void(EventLoop::SessionId)> submit = [&](EventLoop::SessionId id)
+	{
+		loop.Submit(id, msg, [&, id](Client::Res_e res, string_view)
+		{
+			if (Client::Res_e::SUCCESS != res) return;
+			++completed;
+			if (is_running) submit(id);
+		});
+	};
+	for (auto& id : ids)
+	{
+		if (Client::Res_e::SUCCESS != loop.AddSession(params, id)) return -1;
+		for (size_t i = 0; i < depth; ++i) { submit(id); }
+	}
+	
+	auto const begin = chrono::steady_clock::now();
+	auto const end = begin + duration;
+	while (chrono::steady_clock::now() < end) { loop.RunOnce(1); }
+	double const seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	is_running = false;
+	size_t const result = completed;
+	for (auto id : ids) { loop.RemoveSession(id); }
+	return result/seconds;
+}
+
+int main(int argc, char** argv)
+{
+	//thousands of sessions and their server sides need more descriptors than default 1024
+	rlimit rl;
+	getrlimit(RLIMIT_NOFILE, &rl);
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+	
+	chrono::milliseconds const duration{argc > 1 ? atoi(argv[1]) : 1000};
+	LoopbackServer server;
+	if (not server.Start())
+	{
+		cerr << "Server start failed: " << strerror(errno) << '\n';
+		return 1;
+	}
+	
+	cout << "backend\tsessions\tdepth\trequests_per_sec\n";
+	for (auto type : {Poller::Type_e::EPOLL, Poller::Type_e::IO_URING})
+	{
+		for (size_t sessions_qty : {1, 16, 256, 1024, 4096})
+		{
+			if (sessions_qty*2 + 64 > rl.rlim_cur) break;
+			double const rps = Run(type, server.GetPort(), sessions_qty, 8, duration);
+			cout << (Poller::Type_e::EPOLL == type ? "epoll" : "io_uring") << '\t' << sessions_qty << "\t8\t";
+			if (rps < 0) cout << "not available\n";
+			else cout << static_cast<size_t>(rps) << '\n';
+		}
+	}
+	server.Stop();
+	return 0;
+}
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "LoopbackServer.hpp"
+#include "UdpFragmenter.hpp"
+#include "UdpPacket.hpp"
+#include "TcpPacket.hpp"
+#include "UdpReassembler.hpp"
+
+using namespace std;
+
+namespace
+{
+constexpr int MAX_EVENTS = 256;
+constexpr size_t READ_SIZE = 64*1024;
+
+struct TcpConnection
+{
+	string in;
+	string out;
+	size_t out_pos{0};
+};
+
+//requests of one UDP peer
+struct UdpPeer
+{
+	UdpReassembler                     reassembler;
+	unordered_map<uint32_t, string>    requests;
+	uint32_t                           last_id{0};
+	uint16_t                           last_packet_size{0};
+	string                             last_answer;
+};
+
+struct Loss
+{
+	bernoulli_distribution drop;
+	minstd_rand            random{1};
+	
+	explicit Loss(double rate) : drop(rate) {}
+	bool IsDropped() { return drop(random); }
+};
+
+void AnswerTcp(TcpConnection& c)
+{
+	size_t begin = 0;
+	for (size_t end; (end = c.in.find('\n', begin)) != string::npos; begin = end + 1)
+	{
+		c.out.append(c.in, begin, end - begin);
+		if (end > begin and isdigit(static_cast<unsigned char>(c.in[begin]))) { c.out.append("\tOK"); }
+		c.out.push_back('\n');
+	}
+	c.in.erase(0, begin);
+}
+
+void AnswerTcpBin(TcpConnection& c)
+{
+	size_t begin = 0;
+	while (c.in.size() - begin >= TCP_BIN_HEADER_SIZE)
+	{
+		uint32_t size;
+		memcpy(&size, &c.in[begin], sizeof(size));
+		size = ntohl(size);
+		if (c.in.size() - begin - TCP_BIN_HEADER_SIZE < size) break;
+		string_view const request{&c.in[begin + TCP_BIN_HEADER_SIZE], size};
+		bool const is_digit = not request.empty() and isdigit(static_cast<unsigned char>(request[0]));
+		uint32_t const answer_size = htonl(size + (is_digit ? 3 : 0));
+		c.out.append(reinterpret_cast<char const*>(&answer_size), sizeof(answer_size));
+		c.out.append(request);
+		if (is_digit) { c.out.append("\nOK"); }
+		begin += TCP_BIN_HEADER_SIZE + size;
+	}
+	c.in.erase(0, begin);
+}
+
+//false if connection has to be closed
+bool WriteTcp(int desc, TcpConnection& c)
+{
+	while (c.out_pos != c.out.size())
+	{
+		ssize_t const written = send(desc, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (-1 == written) return errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR;
+		c.out_pos += written;
+	}
+	c.out.clear();
+	c.out_pos = 0;
+	return true;
+}
+
+//sends only fragments listed in seq_nums if it is not null
+void AnswerUdp(int desc, sockaddr_in const& peer, UdpPeer const& p, vector<uint16_t> const* seq_nums, bool has_msg_id, Loss& loss)
+{
+	UdpFragmenter fragmenter;
+	fragmenter.SetMessageId(has_msg_id);
+	fragmenter.Build(p.last_answer, p.last_packet_size, p.last_id, false, &peer);
+	vector<uint16_t> selected;
+	for (uint16_t seq_num = 0; seq_num < fragmenter.GetPacketsQty(); ++seq_num)
+	{
+		if (seq_nums and find(seq_nums->begin(), seq_nums->end(), seq_num) == seq_nums->end()) continue;
+		if (not loss.IsDropped()) { selected.push_back(seq_num); }
+	}
+	fragmenter.Select(selected.data(), selected.size());
+	while (not fragmenter.IsSent())
+	{
+		if (-1 == fragmenter.Send(desc, 0) and errno != EINTR and errno != EAGAIN) return;
+	}
+}
+}
+
+LoopbackServer::~LoopbackServer()
+{
+	Stop();
+}
+
+bool LoopbackServer::Start(uint16_t port)
+{
+	sockaddr_in sa{};
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sa.sin_port = htons(port);
+	
+	m_tcp_desc = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	int const on = 1;
+	setsockopt(m_tcp_desc, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (-1 == bind(m_tcp_desc, (sockaddr*)&sa, sizeof(sa)) or -1 == listen(m_tcp_desc, 4096)) return false;
+	socklen_t len = sizeof(sa);
+	getsockname(m_tcp_desc, (sockaddr*)&sa, &len);
+	m_port = ntohs(sa.sin_port);
+	
+	m_udp_desc = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	int const buffer_size = 8*1024*1024;
+	setsockopt(m_udp_desc, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+	setsockopt(m_udp_desc, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+	if (-1 == bind(m_udp_desc, (sockaddr*)&sa, sizeof(sa))) return false;
+	
+	m_is_stopped = false;
+	m_thread = thread([this]{ Run(); });
+	return true;
+}
+
+void LoopbackServer::Stop()
+{
+	m_is_stopped = true;
+	if (m_thread.joinable()) { m_thread.join(); }
+	if (-1 != m_tcp_desc) { close(m_tcp_desc); }
+	if (-1 != m_udp_desc) { close(m_udp_desc); }
+	m_tcp_desc = m_udp_desc = -1;
+}
+
+void LoopbackServer::Run()
+{
+	int const ep = epoll_create1(0);
+	for (int desc : {m_tcp_desc, m_udp_desc})
+	{
+		epoll_event ev{EPOLLIN, {}};
+		ev.data.fd = desc;
+		epoll_ctl(ep, EPOLL_CTL_ADD, desc, &ev);
+	}
+	unordered_map<int, TcpConnection> connections;
+	map<pair<uint32_t, uint16_t>, unique_ptr<UdpPeer>> peers;
+	string buffer(READ_SIZE, '\0');
+	epoll_event events[MAX_EVENTS];
+	Loss loss(m_loss_rate);
+	vector<uint16_t> seq_nums;
+	
+	while (not m_is_stopped)
+	{
+		int const n = epoll_wait(ep, events, MAX_EVENTS, 10);
+		for (int i = 0; i < n; ++i)
+		{
+			int const desc = events[i].data.fd;
+			if (desc == m_tcp_desc)
+			{
+				for (int c; -1 != (c = accept4(m_tcp_desc, nullptr, nullptr, SOCK_NONBLOCK));)
+				{
+					epoll_event ev{EPOLLIN, {}};
+					ev.data.fd = c;
+					epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+					connections[c];
+				}
+			}
+			else if (desc == m_udp_desc)
+			{
+				sockaddr_in peer;
+				socklen_t len = sizeof(peer);
+				ssize_t r;
+				while ((r = recvfrom(m_udp_desc, buffer.data(), buffer.size(), 0, (sockaddr*)&peer, &len)) > 0)
+				{
+					len = sizeof(peer);
+					if (loss.IsDropped()) continue;
+					auto& p = peers[{peer.sin_addr.s_addr, peer.sin_port}];
+					if (not p)
+					{
+						p = make_unique<UdpPeer>();
+						p->reassembler.SetMessageId(m_udp_has_msg_id);
+					}
+					
+					if (static_cast<size_t>(r) >= UDP_RESEND_HEADER_SIZE and string_view{buffer.data(), UDP_RESEND_BEGIN.size()} == UDP_RESEND_BEGIN)
+					{
+						uint32_t msg_id;
+						uint16_t qty;
+						memcpy(&msg_id, buffer.data() + UDP_RH_MSG_ID_POS, sizeof(msg_id));
+						memcpy(&qty, buffer.data() + UDP_RH_QTY_POS, sizeof(qty));
+						if (ntohl(msg_id) != p->last_id) continue;
+						qty = min<size_t>(ntohs(qty), (r - UDP_RESEND_HEADER_SIZE)/2);
+						seq_nums.resize(qty);
+						for (uint16_t i = 0; i < qty; ++i)
+						{
+							memcpy(&seq_nums[i], buffer.data() + UDP_RESEND_HEADER_SIZE + i*2, sizeof(seq_nums[i]));
+							seq_nums[i] = ntohs(seq_nums[i]);
+						}
+						AnswerUdp(m_udp_desc, peer, *p, &seq_nums, m_udp_has_msg_id, loss);
+						continue;
+					}
+					if (static_cast<size_t>(r) < UdpHeaderSize(m_udp_has_msg_id)) continue;
+					//without MESSAGE_ID every peer has one request at a time
+					uint32_t msg_id = 0;
+					uint16_t packet_size;
+					if (m_udp_has_msg_id)
+					{
+						memcpy(&msg_id, buffer.data() + UDP_PH_MSG_ID_POS, sizeof(msg_id));
+						msg_id = ntohl(msg_id);
+					}
+					memcpy(&packet_size, buffer.data() + UDP_PH_SIZE_POS, sizeof(packet_size));
+					packet_size = ntohs(packet_size);
+					
+					auto it = p->requests.find(msg_id);
+					if (it == p->requests.end())
+					{
+						it = p->requests.emplace(msg_id, string{}).first;
+						p->reassembler.Expect(msg_id, it->second);
+					}
+					uint32_t added_id;
+					auto added = p->reassembler.Add(buffer.data(), r, added_id);
+					//without MESSAGE_ID fragment which does not fit unfinished request starts the next one,
+					//client does not repeat requests of several fragments
+					if (not m_udp_has_msg_id and (UdpReassembler::Res_e::DUPLICATED == added or UdpReassembler::Res_e::DAMAGED == added))
+					{
+						p->reassembler.Forget(msg_id);
+						it->second.clear();
+						p->reassembler.Expect(msg_id, it->second);
+						added = p->reassembler.Add(buffer.data(), r, added_id);
+					}
+					if (UdpReassembler::Res_e::MESSAGE_COMPLETED == added)
+					{
+						p->last_id = msg_id;
+						p->last_packet_size = packet_size;
+						p->last_answer = move(it->second);
+						p->requests.erase(it);
+						AnswerUdp(m_udp_desc, peer, *p, nullptr, m_udp_has_msg_id, loss);
+					}
+				}
+			}
+			else
+			{
+				TcpConnection& c = connections[desc];
+				ssize_t r;
+				while ((r = recv(desc, buffer.data(), buffer.size(), MSG_DONTWAIT)) > 0) { c.in.append(buffer.data(), r); }
+				bool is_closed = (0 == r) or (-1 == r and errno != EAGAIN and errno != EWOULDBLOCK);
+				if (not is_closed)
+				{
+					if (m_tcp_binary) AnswerTcpBin(c);
+					else AnswerTcp(c);
+					is_closed = not WriteTcp(desc, c);
+				}
+				if (is_closed)
+				{
+					close(desc);
+					connections.erase(desc);
+					continue;
+				}
+				epoll_event ev{EPOLLIN | (c.out.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT)), {}};
+				ev.data.fd = desc;
+				epoll_ctl(ep, EPOLL_CTL_MOD, desc, &ev);
+			}
+		}
+	}
+	for (auto& c : connections) { close(c.first); }
+	close(ep);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+//Stand-in of protey server for benchmarks, TCP and UDP on the same loopback port.
+//TCP: every '\n' terminated request is answered by itself, request starting with digit
+//gets second line "OK" which is joined by '\t' like real server does.
+//With TCPBIN framing request and answer are length prefixed and "OK" is joined by '\n'.
+//UDP: fragmented request is answered by itself with the same fragment size and MESSAGE_ID if it is enabled,
+//the last answer of every peer is kept to serve its resend requests.
+class LoopbackServer
+{
+public:
+	~LoopbackServer();
+	//0 port means any free one
+	bool Start(uint16_t port = 0);
+	void Stop();
+	uint16_t GetPort() const { return m_port; }
+	//probability to drop every received and sent UDP datagram, set before Start
+	void SetLossRate(double rate) { m_loss_rate = rate; }
+	//TCP connections use TCPBIN framing, set before Start
+	void SetTcpBinary(bool enable) { m_tcp_binary = enable; }
+	//UDP fragments carry MESSAGE_ID, set before Start
+	void SetUdpMessageId(bool enable) { m_udp_has_msg_id = enable; }
+private:
+	void Run();
+	
+	int               m_tcp_desc{-1};
+	int               m_udp_desc{-1};
+	uint16_t          m_port{0};
+	double            m_loss_rate{0};
+	bool              m_tcp_binary{false};
+	bool              m_udp_has_msg_id{false};
+	std::atomic<bool> m_is_stopped{false};
+	std::thread       m_thread;
+};
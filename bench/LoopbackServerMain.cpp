@@ -0,0 +1,33 @@
+//Standalone stand-in server for manual runs of protey_client
+//Usage: loopback_server [port] [UDP loss rate] [--udp-msg-id] [--tcpbin]
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "LoopbackServer.hpp"
+
+int main(int argc, char** argv)
+{
+	LoopbackServer server;
+	//options may go anywhere, the rest are port and loss rate in this order
+	std::vector<char const*> positional;
+	bool is_tcp_binary = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string const arg = argv[i];
+		if (arg == "--udp-msg-id") server.SetUdpMessageId(true);
+		else if (arg == "--tcpbin") is_tcp_binary = true;
+		else positional.push_back(argv[i]);
+	}
+	server.SetTcpBinary(is_tcp_binary);
+	server.SetLossRate(positional.size() > 1 ? atof(positional[1]) : 0);
+	if (not server.Start(positional.size() > 0 ? atoi(positional[0]) : 0))
+	{
+		std::cerr << "Server start failed\n";
+		return 1;
+	}
+	std::cout << "Listening on 127.0.0.1:" << server.GetPort() << " TCP" << (is_tcp_binary ? "BIN" : "") << " and UDP\n";
+	pause();
+	return 0;
+}
@@ -0,0 +1,96 @@
+//Compares UdpReassembler with the previous vector+find reassembly loop of Client::SendMsg
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <arpa/inet.h>
+#include "UdpPacket.hpp"
+#include "UdpReassembler.hpp"
+
+using namespace std;
+
+constexpr uint16_t packet_size = 64;
+constexpr uint16_t payload_size = packet_size - UDP_PACKET_HEADER_SIZE;
+
+vector<string> MakeFragments(uint16_t packets_qty)
+{
+	vector<string> fragments(packets_qty);
+	for (uint16_t i = 0; i < packets_qty; ++i)
+	{
+		string& f = fragments[i];
+		f.resize(packet_size);
+		memcpy(f.data(), UDP_PACKET_BEGIN.data(), UDP_PACKET_BEGIN.size());
+		uint16_t const qty_net = htons(packets_qty), seq_net = htons(i), ps_net = htons(packet_size);
+		memcpy(f.data() + UDP_PH_QTY_POS, &qty_net, sizeof(qty_net));
+		memcpy(f.data() + UDP_PH_SEQ_NUM_POS, &seq_net, sizeof(seq_net));
+		memcpy(f.data() + UDP_PH_SIZE_POS, &ps_net, sizeof(ps_net));
+		memset(f.data() + UDP_PACKET_HEADER_SIZE, 'a' + i%26, payload_size);
+	}
+	return fragments;
+}
+
+//reassembly loop as it was before UdpReassembler
+void LegacyReassemble(vector<string> const& fragments, string& answer)
+{
+	uint16_t rd_packets_qty = 0;
+	vector<size_t> packet_numbers;
+	for (auto const& f : fragments)
+	{
+		uint16_t rd_packet_number;
+		memcpy(&rd_packet_number, f.data() + UDP_PH_SEQ_NUM_POS, sizeof(rd_packet_number));
+		rd_packet_number = ntohs(rd_packet_number);
+		if (find(packet_numbers.begin(), packet_numbers.end(), rd_packet_number) != packet_numbers.end()) continue;
+		if (packet_numbers.empty())
+		{
+			memcpy(&rd_packets_qty, f.data() + UDP_PH_QTY_POS, sizeof(rd_packets_qty));
+			rd_packets_qty = ntohs(rd_packets_qty);
+			answer.resize(rd_packets_qty*payload_size);
+		}
+		packet_numbers.push_back(rd_packet_number);
+		memcpy(&answer[rd_packet_number*payload_size], f.data() + UDP_PACKET_HEADER_SIZE, f.size() - UDP_PACKET_HEADER_SIZE);
+	}
+}
+
+void NewReassemble(UdpReassembler& reassembler, vector<string> const& fragments, string& answer)
+{
+	reassembler.Expect(1, answer);
+	uint32_t msg_id;
+	for (auto const& f : fragments) { reassembler.Add(f.data(), f.size(), msg_id); }
+}
+
+template<class F>
+double MeasureUs(F&& f, int rounds)
+{
+	auto const begin = chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i) { f(); }
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count()/rounds;
+}
+
+int main()
+{
+	mt19937 rng(1);
+	cout << "fragments\torder\tlegacy_us\treassembler_us\n";
+	for (uint16_t qty : {uint16_t{1000}, uint16_t{65000}})
+	{
+		auto fragments = MakeFragments(qty);
+		int const rounds = (qty > 10000) ? 1 : 200;
+		for (bool shuffled : {false, true})
+		{
+			if (shuffled) { shuffle(fragments.begin(), fragments.end(), rng); }
+			string legacy_answer, answer;
+			UdpReassembler reassembler;
+			double const legacy_us = MeasureUs([&]{ LegacyReassemble(fragments, legacy_answer); }, rounds);
+			double const new_us = MeasureUs([&]{ NewReassemble(reassembler, fragments, answer); }, rounds);
+			if (legacy_answer != answer)
+			{
+				cerr << "Answers differ\n";
+				return 1;
+			}
+			cout << qty << '\t' << (shuffled ? "shuffled" : "ordered") << '\t' << legacy_us << '\t' << new_us << '\n';
+		}
+	}
+	return 0;
+}
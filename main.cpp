@@ -1,12 +1,36 @@
 #include <iostream>
 #include <string>
+#include <thread>
 #include "Client.hpp"
+#include "Replay.hpp"
 
-int main(){
+//Usage: protey_client - interactive mode
+//       protey_client [--udp-msg-id] PROTO,IP,PORT REQUESTS_FILE [ANSWERS_FILE] - requests are lines of file, answers go to file or stdout,
+//       --udp-msg-id lets UDP requests carry MESSAGE_ID if server supports it
+int main(int argc, char** argv){
+	bool const has_udp_msg_id = argc > 1 && std::string(argv[1]) == "--udp-msg-id";
+	if (has_udp_msg_id)
+	{
+		--argc;
+		++argv;
+	}
+	if (argc > 2)
+	{
+		Replay replay;
+		replay.SetUdpMessageId(has_udp_msg_id);
+		if (!replay.Open(argv[2], argc > 3 ? argv[3] : nullptr))
+		{
+			return 1;
+		}
+		auto const res = replay.Run(argv[1]);
+		replay.PrintSummary(stderr);
+		return Client::Res_e::SUCCESS == res ? 0 : 1;
+	}
 	std::cout<<"Specify protocol(TCP/UDP),server IPv4 address and port like(tcp,10.10.10.10,5555)\n";
 	std::string params;
 	std::cin>>params;
 	Client client;
+	client.SetReconnect(true);
 	if (Client::Res_e::SUCCESS != client.Start(params))
 	{
 		return 0;
@@ -16,11 +40,19 @@ int main(){
 	while(1)
 	{
 		std::cout<<"Input string\n";
-		std::getline(std::cin, s);
+		if (!std::getline(std::cin, s))
+		{
+			break;
+		}
 		auto res = client.SendMsg(s);
+		//broken TCP connection is restored by client itself, request is repeated until it is connected
 		while (Client::Res_e::SUCCESS != res && Client::Res_e::NO_DATA_TO_SEND != res)
 		{
-			if (Client::Res_e::CONNECTION_BROKEN == res)
+			if (Client::Res_e::RECONNECTING == res)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			else if (Client::Res_e::NOT_STARTED == res)
 			{
 				if (Client::Res_e::SUCCESS != client.Start())
 				{
@@ -29,7 +61,10 @@ int main(){
 			}
 			res = client.SendMsg(s);
 		}
-		
+		if (Client::Res_e::SUCCESS == res)
+		{
+			std::cout<<client.GetLastReceivedAnswer()<<'\n';
+		}
 	}
 	return 0;
 };